@@ -0,0 +1,40 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "tensormidi/shard.h"
+
+using namespace tensormidi;
+
+// Packs the midi files listed on stdin into one shard with a random access index
+// Use --parsed to store ready-to-map .tmidi images instead of raw midi bytes
+//   find data -name '*.mid' | ./pack data.tmsh
+
+int main(int argc, char ** argv)
+{
+    if(argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " out.tmsh [--parsed] < paths" << std::endl;
+        return 1;
+    }
+    std::string out = argv[1];
+    bool parsed = (argc > 2 && std::string(argv[2]) == "--parsed");
+
+    std::vector<std::string> paths;
+    for(std::string line ; std::getline(std::cin, line) ; )
+        if(line.size()) { paths.push_back(line); }
+
+    try
+    {
+        pack_shard(paths, out, parsed ? ShardHeader::PARSED : ShardHeader::RAW, {});
+        Shard shard { out };
+        size_t failed = 0;
+        for(size_t i=0 ; i<shard.size() ; i++) { failed += shard.index[i].status != 0; }
+        std::cout << shard.size() << " files, " << failed << " failed" << std::endl;
+    }
+    catch(std::exception const& e)
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -1,4 +1,6 @@
 from . import tensormidi_bind as _ext
+import ctypes
+import functools
 import numpy
 
 NOTE_OFF = 0x80
@@ -23,6 +25,120 @@ TEMPO_DTYPE = numpy.dtype([
     ('sec_per_beat', 'f8')
 ])
 
+METADATA_DTYPE = numpy.dtype([
+    ('duration', 'f8'),
+    ('programs', 'u8', (2,)),
+    ('notes', 'u4'),
+    ('channels', 'u2'),
+    ('n_tracks', 'u2'),
+    ('min_bpm', 'f4'),
+    ('max_bpm', 'f4'),
+    ('ticks_per_beat', 'u2'),
+    ('type', 'u1'),
+    ('n_time_signatures', 'u1'),
+    ('numerator', 'u1'),
+    ('denominator', 'u1'),
+    ('status', 'i2'),
+])
+
+SHARD_INDEX_DTYPE = numpy.dtype([
+    ('offset', 'u8'),
+    ('length', 'u8'),
+    ('hash', 'u8'),
+    ('n_events', 'u4'),
+    ('n_tracks', 'u2'),
+    ('ticks_per_beat', 'u2'),
+    ('duration', 'f4'),
+    ('status', 'i4'),
+])
+
+# time_unit codes for parse_into
+TICKS = 0
+SECONDS = 1
+BEATS = 2
+GRID = 3
+
+# C function pointer, callable from python and from numba nopython code
+parse_into = ctypes.CFUNCTYPE(
+    ctypes.c_int64, # events in file (may exceed capacity), -1 on error
+    ctypes.c_void_p, # midi file bytes
+    ctypes.c_int64, # byte count
+    ctypes.c_void_p, # TRACK_DTYPE output buffer
+    ctypes.c_int64, # buffer capacity in events
+    ctypes.c_int32, # merge_tracks
+    ctypes.c_int32, # time_unit code
+    ctypes.c_int32, # notes_only
+    ctypes.c_int32, # default_program
+    ctypes.c_int32, # steps_per_beat, for GRID
+    ctypes.c_void_p, # int32 ticks_per_beat output, or 0
+)(_ext.parse_into_address())
+
+
+_cache_enabled = False
+
+
+def set_cache(max_bytes):
+    global _cache_enabled
+    _ext.set_cache(max_bytes)
+    _cache_enabled = max_bytes > 0
+
+
+def clear_cache():
+    _ext.clear_cache()
+
+
+def cache_info():
+    return _ext.cache_info()
+
+
+def _time_unit(seconds, time_unit, quantize):
+    if quantize:
+        if time_unit not in (None, 'grid'):
+            raise ValueError(f"quantize gives grid times, not time_unit='{time_unit}'")
+        return 'grid'
+    if time_unit is None:
+        return 'seconds' if seconds else 'ticks'
+    return time_unit
+
+
+def _wrap(loaded, merge_tracks, time_unit, beat_column, residual, readonly=False):
+    tracks, tempos, tick_per_beat, beats, residuals = loaded
+    if readonly:
+        # shared with the parse cache, so nobody may write to them
+        for x in [*tracks, tempos, *beats, *residuals]:
+            x.flags.writeable = False
+    tracks = [
+        x.view(TRACK_DTYPE)[:, 0].view(numpy.recarray)
+        for x in tracks
+    ]
+    tracks = tracks[0] if merge_tracks else tracks
+    beats = beats[0] if merge_tracks and beat_column else beats
+    residuals = residuals[0] if merge_tracks and residual else residuals
+    if time_unit == 'seconds':
+        return (tracks, beats) if beat_column else tracks
+    elif time_unit == 'beats':
+        return tracks
+    elif time_unit == 'grid':
+        return (tracks, residuals) if residual else tracks
+    else:
+        tempos = tempos.view(TEMPO_DTYPE)[:,0].view(numpy.recarray)
+        return tracks, tempos, tick_per_beat
+
+
+def _out_bytes(out):
+    # parsed events are written in place, so a copy would silently drop them
+    if out.dtype != TRACK_DTYPE:
+        raise ValueError('out must be a TRACK_DTYPE array')
+    if not out.flags.c_contiguous or not out.flags.writeable:
+        raise ValueError('out must be a writeable C-contiguous array')
+    return out.view(numpy.uint8)
+
+
+def _check_overflow(count, capacity, overflow):
+    if count > capacity and overflow == 'raise':
+        raise OverflowError(f'{count} events do not fit in {capacity}')
+    return min(count, capacity)
+
 
 def load(
     filename,
@@ -30,21 +146,1048 @@ def load(
     seconds = True,
     notes_only = True,
     default_program = 0,
+    time_unit = None,
+    beat_column = False,
+    quantize = 0,
+    residual = False,
+    out = None,
+    overflow = 'raise',
 ):
-    tracks, tempos, tick_per_beat = _ext.load_midi(
+    time_unit = _time_unit(seconds, time_unit, quantize)
+    if out is not None:
+        if beat_column or residual:
+            raise ValueError('beat_column and residual are not supported with out')
+        count, tempos, tick_per_beat = _ext.load_into(
+            filename,
+            _out_bytes(out),
+            merge_tracks=merge_tracks,
+            time_unit=time_unit,
+            notes_only=notes_only,
+            default_program=default_program,
+            steps_per_beat=quantize,
+        )
+        count = _check_overflow(count, len(out), overflow)
+        if time_unit == 'ticks':
+            tempos = tempos.view(TEMPO_DTYPE)[:,0].view(numpy.recarray)
+            return count, tempos, tick_per_beat
+        return count
+
+    loaded = _ext.load_midi(
         filename, 
         merge_tracks=merge_tracks,
-        seconds=seconds,
+        time_unit=time_unit,
+        notes_only=notes_only, 
+        default_program=default_program,
+        beat_column=beat_column,
+        steps_per_beat=quantize,
+        residual=residual,
+    )
+    return _wrap(loaded, merge_tracks, time_unit, beat_column, residual,
+        readonly=_cache_enabled)
+
+
+def load_batch(
+    filenames,
+    merge_tracks = True,
+    seconds = True,
+    notes_only = True,
+    default_program = 0,
+    time_unit = None,
+    beat_column = False,
+    quantize = 0,
+    residual = False,
+    out = None,
+    overflow = 'raise',
+    threads = 0,
+    arrow = False,
+):
+    time_unit = _time_unit(seconds, time_unit, quantize)
+    filenames = [str(f) for f in filenames]
+    if arrow:
+        return _ext.load_batch_arrow(
+            filenames,
+            merge_tracks=merge_tracks,
+            time_unit=time_unit,
+            notes_only=notes_only,
+            default_program=default_program,
+            steps_per_beat=quantize,
+            threads=threads,
+        )
+    if out is not None:
+        if beat_column or residual:
+            raise ValueError('beat_column and residual are not supported with out')
+        counts = _ext.load_batch_into(
+            filenames,
+            _out_bytes(out),
+            merge_tracks=merge_tracks,
+            time_unit=time_unit,
+            notes_only=notes_only,
+            default_program=default_program,
+            steps_per_beat=quantize,
+            threads=threads,
+        )
+        capacity = out.shape[1]
+        return numpy.array([
+            _check_overflow(c, capacity, overflow) for c in counts
+        ], dtype=numpy.int64)
+
+    loaded = _ext.load_batch(
+        filenames, 
+        merge_tracks=merge_tracks,
+        time_unit=time_unit,
         notes_only=notes_only, 
         default_program=default_program,
+        beat_column=beat_column,
+        steps_per_beat=quantize,
+        residual=residual,
+        threads=threads,
     )
+    return [
+        _wrap(x, merge_tracks, time_unit, beat_column, residual,
+            readonly=_cache_enabled)
+        for x in loaded
+    ]
+
+
+def load_columns(
+    filename,
+    framework = 'numpy',
+    time_dtype = 'float64',
+    merge_tracks = True,
+    seconds = True,
+    notes_only = True,
+    default_program = 0,
+    time_unit = None,
+    quantize = 0,
+):
+    time_unit = _time_unit(seconds, time_unit, quantize)
+    tracks = _ext.load_columns(
+        filename,
+        framework=framework,
+        time_dtype=time_dtype,
+        merge_tracks=merge_tracks,
+        time_unit=time_unit,
+        notes_only=notes_only,
+        default_program=default_program,
+        steps_per_beat=quantize,
+    )
+    return tracks[0] if merge_tracks else tracks
+
+
+def _as_bytes(x, dtype):
+    return numpy.ascontiguousarray(x, dtype=dtype).view(numpy.uint8)
+
+
+def save(
+    filename,
+    tracks,
+    tempos = None,
+    ticks_per_beat = 0,
+    time_unit = None,
+    quantize = 0,
+):
+    merged = not isinstance(tracks, (list, tuple))
+    tracks = [tracks] if merged else tracks
+    if time_unit is None:
+        if not quantize and tempos is None:
+            raise ValueError('time_unit is required without tempos or quantize')
+        time_unit = 'grid' if quantize else 'ticks'
+    elif quantize:
+        time_unit = _time_unit(False, time_unit, quantize)
+    if tempos is None:
+        tempos = numpy.zeros(0, TEMPO_DTYPE)
+    _ext.save_cache(
+        filename,
+        [_as_bytes(x, TRACK_DTYPE) for x in tracks],
+        _as_bytes(tempos, TEMPO_DTYPE),
+        ticks_per_beat=ticks_per_beat,
+        time_unit=time_unit,
+        merged=merged,
+        steps_per_beat=quantize,
+    )
+
+
+def _wrap_cached(cached):
+    tracks, tempos, tick_per_beat, time_unit, merged = cached[:5]
     tracks = [
         x.view(TRACK_DTYPE)[:, 0].view(numpy.recarray)
         for x in tracks
     ]
-    tracks = tracks[0] if merge_tracks else tracks
-    if seconds:
-        return tracks
-    else:
+    tracks = tracks[0] if merged else tracks
+    if time_unit == 'ticks':
         tempos = tempos.view(TEMPO_DTYPE)[:,0].view(numpy.recarray)
         return tracks, tempos, tick_per_beat
+    return tracks
+
+
+def _check_cached(
+    cached,
+    merge_tracks,
+    seconds,
+    notes_only,
+    default_program,
+    time_unit,
+    beat_column,
+    quantize,
+    residual,
+):
+    # parsed events can't be re-parsed, so options must agree with the packed ones
+    _, _, _, unit, merged, steps, parsed_notes_only, program = cached
+    if beat_column or residual:
+        raise ValueError('parsed shards hold no beat_column or residual')
+    conflicts = []
+    if merge_tracks is not None and bool(merge_tracks) != merged:
+        conflicts.append('merge_tracks')
+    if seconds is not None or time_unit is not None or quantize:
+        want = _time_unit(True if seconds is None else seconds, time_unit, quantize)
+        if want != unit or (quantize and quantize != steps):
+            conflicts.append('time_unit')
+    known = parsed_notes_only != 0
+    if notes_only is not None and (not known or bool(notes_only) != (parsed_notes_only == 1)):
+        conflicts.append('notes_only')
+    if default_program is not None and (not known or default_program != program):
+        conflicts.append('default_program')
+    if conflicts:
+        raise ValueError(f'shard was packed with other {", ".join(conflicts)}')
+
+
+def load_cached(filename):
+    return _wrap_cached(_ext.load_cached(filename))
+
+
+def pack(
+    filenames,
+    out,
+    parsed = False,
+    merge_tracks = True,
+    seconds = True,
+    notes_only = True,
+    default_program = 0,
+    time_unit = None,
+    quantize = 0,
+    threads = 0,
+):
+    _ext.pack(
+        [str(f) for f in filenames],
+        str(out),
+        parsed=parsed,
+        merge_tracks=merge_tracks,
+        time_unit=_time_unit(seconds, time_unit, quantize),
+        notes_only=notes_only,
+        default_program=default_program,
+        steps_per_beat=quantize,
+        threads=threads,
+    )
+
+
+class Shard:
+    def __init__(self, filename):
+        self._shard = _ext.Shard(str(filename))
+        self.parsed = self._shard.parsed
+        self.index = self._shard.index().view(SHARD_INDEX_DTYPE)[:, 0].view(numpy.recarray)
+
+    def __len__(self):
+        return len(self._shard)
+
+    def raw(self, i):
+        return self._shard.raw(i)
+
+    def load(
+        self,
+        i,
+        merge_tracks = None,
+        seconds = None,
+        notes_only = None,
+        default_program = None,
+        time_unit = None,
+        beat_column = False,
+        quantize = 0,
+        residual = False,
+    ):
+        # None leaves parsed shards as packed, and means load()'s default otherwise
+        if self.parsed:
+            cached = self._shard.load_cached(i)
+            _check_cached(cached, merge_tracks, seconds, notes_only, default_program,
+                time_unit, beat_column, quantize, residual)
+            return _wrap_cached(cached)
+        merge_tracks = True if merge_tracks is None else merge_tracks
+        time_unit = _time_unit(True if seconds is None else seconds, time_unit, quantize)
+        loaded = self._shard.load(
+            i,
+            merge_tracks=merge_tracks,
+            time_unit=time_unit,
+            notes_only=True if notes_only is None else notes_only,
+            default_program=default_program or 0,
+            beat_column=beat_column,
+            steps_per_beat=quantize,
+            residual=residual,
+        )
+        return _wrap(loaded, merge_tracks, time_unit, beat_column, residual)
+
+    def __getitem__(self, i):
+        return self.load(i)
+
+    def sample(
+        self,
+        batch,
+        n_events = None,
+        duration = None,
+        seed = None,
+        out = None,
+        seconds = None,
+        notes_only = None,
+        default_program = None,
+        time_unit = None,
+        quantize = 0,
+        threads = 0,
+    ):
+        # options as in Shard.load, parsed shards check them against their first usable file
+        if (n_events is None) == (duration is None):
+            raise ValueError('pass exactly one of n_events or duration')
+        if self.parsed:
+            usable = numpy.nonzero(self.index.status == 0)[0]
+            if len(usable):
+                _check_cached(self._shard.load_cached(int(usable[0])), None, seconds,
+                    notes_only, default_program, time_unit, False, quantize, False)
+        if seed is None:
+            seed = int(numpy.random.randint(0, 2**63, dtype=numpy.int64))
+        options = dict(
+            time_unit=_time_unit(True if seconds is None else seconds, time_unit, quantize),
+            notes_only=True if notes_only is None else notes_only,
+            default_program=default_program or 0,
+            steps_per_beat=quantize,
+            threads=threads,
+        )
+        if duration is not None:
+            events, offsets, files = self._shard.sample_time(
+                batch, seed, duration, **options)
+            events = events.view(TRACK_DTYPE)[:, 0].view(numpy.recarray)
+            return events, numpy.array(offsets, numpy.int64), numpy.array(files, numpy.int64)
+        if out is None:
+            out = numpy.zeros((batch, n_events), TRACK_DTYPE).view(numpy.recarray)
+        files, counts = self._shard.sample_events(
+            batch, seed, _out_bytes(out), **options)
+        return out, numpy.array(counts, numpy.int64), numpy.array(files, numpy.int64)
+
+
+class MidiFile:
+    def __init__(
+        self,
+        filename,
+        seconds = True,
+        notes_only = True,
+        default_program = 0,
+        time_unit = None,
+        quantize = 0,
+    ):
+        self._file = _ext.LazyMidi(str(filename))
+        self._options = dict(
+            time_unit=_time_unit(seconds, time_unit, quantize),
+            notes_only=notes_only,
+            default_program=default_program,
+            steps_per_beat=quantize,
+        )
+        self._tracks = {}
+        self.type = self._file.type
+        self.ticks_per_beat = self._file.ticks_per_beat
+        self.track_lengths = numpy.array(self._file.track_lengths(), numpy.int64)
+
+    def __len__(self):
+        return len(self.track_lengths)
+
+    def track(self, i):
+        i = range(len(self))[i]
+        if i not in self._tracks:
+            x = self._file.track(i, **self._options)
+            self._tracks[i] = x.view(TRACK_DTYPE)[:, 0].view(numpy.recarray)
+        return self._tracks[i]
+
+    def __getitem__(self, i):
+        return self.track(i)
+
+    @property
+    def tracks(self):
+        return [self.track(i) for i in range(len(self))]
+
+    @functools.cached_property
+    def tempos(self):
+        return self._file.tempos().view(TEMPO_DTYPE)[:, 0].view(numpy.recarray)
+
+    @functools.cached_property
+    def merged(self):
+        x = self._file.merged(**self._options)
+        return x.view(TRACK_DTYPE)[:, 0].view(numpy.recarray)
+
+
+def probe(filename, estimate=False, prefix=4096):
+    type, n_tracks, ticks_per_beat, size, lengths, events = _ext.probe(
+        str(filename), estimate=estimate, prefix=prefix)
+    out = dict(
+        type=type,
+        n_tracks=n_tracks,
+        ticks_per_beat=ticks_per_beat,
+        size=size,
+        track_lengths=numpy.array(lengths, numpy.int64),
+    )
+    if estimate:
+        out['events'] = events
+    return out
+
+
+def probe_batch(filenames, estimate=False, prefix=4096, threads=0):
+    columns = _ext.probe_batch(
+        [str(f) for f in filenames], 
+        estimate=estimate, 
+        prefix=prefix,
+        threads=threads,
+    )
+    names = ['type', 'n_tracks', 'ticks_per_beat', 'size',
+        'track_lengths', 'track_offsets', 'events', 'status']
+    out = {k: numpy.array(v, numpy.int64) for k, v in zip(names, columns)}
+    if not estimate:
+        del out['events']
+    return out
+
+
+class CorpusIndex:
+    def __init__(self, paths, table):
+        self.paths = numpy.asarray(paths, dtype=str)
+        self.table = table.view(numpy.recarray)
+
+    @classmethod
+    def build(cls, filenames, default_program=0, threads=0):
+        filenames = [str(f) for f in filenames]
+        rows = _ext.describe_batch(
+            filenames, 
+            default_program=default_program, 
+            threads=threads,
+        )
+        return cls(filenames, rows.view(METADATA_DTYPE)[:, 0])
+
+    def save(self, filename):
+        numpy.savez(filename, paths=self.paths, table=numpy.asarray(self.table))
+
+    @classmethod
+    def load(cls, filename):
+        with numpy.load(filename) as f:
+            return cls(f['paths'], f['table'])
+
+    def __len__(self):
+        return len(self.table)
+
+    def __getattr__(self, name):
+        # columns only, as copy and pickle look up hooks before table is set
+        if name not in METADATA_DTYPE.names:
+            raise AttributeError(name)
+        return getattr(self.table, name)
+
+    def has_program(self, program):
+        word = self.table.programs[:, program >> 6]
+        return (word >> numpy.uint64(program & 63)) & numpy.uint64(1) == 1
+
+    def has_channel(self, channel):
+        return (self.table.channels >> channel) & 1 == 1
+
+    def where(
+        self,
+        min_duration = None,
+        max_duration = None,
+        min_notes = None,
+        max_notes = None,
+        min_bpm = None,
+        max_bpm = None,
+        programs = None,
+        all_programs = None,
+        no_programs = None,
+        drums = None,
+        time_signature = None,
+        type = None,
+        ok = True,
+    ):
+        t = self.table
+        mask = numpy.ones(len(t), bool)
+        def cut(keep):
+            numpy.logical_and(mask, keep, out=mask)
+        if ok: cut(t.status == 0)
+        if min_duration is not None: cut(t.duration >= min_duration)
+        if max_duration is not None: cut(t.duration <= max_duration)
+        if min_notes is not None: cut(t.notes >= min_notes)
+        if max_notes is not None: cut(t.notes <= max_notes)
+        if min_bpm is not None: cut(t.min_bpm >= min_bpm)
+        if max_bpm is not None: cut(t.max_bpm <= max_bpm)
+        if programs is not None:
+            cut(numpy.any([self.has_program(p) for p in programs], axis=0))
+        for p in all_programs or []: cut(self.has_program(p))
+        for p in no_programs or []: cut(~self.has_program(p))
+        if drums is not None: cut(self.has_channel(9) == drums)
+        if time_signature is not None:
+            cut((t.numerator == time_signature[0]) & (t.denominator == time_signature[1]))
+        if type is not None: cut(t.type == type)
+        return mask
+
+    def select(self, **predicates):
+        return self.paths[self.where(**predicates)]
+
+
+def content_hashes(
+    filenames,
+    resolution = 960,
+    ignore_program = False,
+    velocity = False,
+    threads = 0,
+):
+    hashes, status, groups = _ext.content_hashes(
+        [str(f) for f in filenames],
+        resolution=resolution,
+        ignore_program=ignore_program,
+        velocity=velocity,
+        threads=threads,
+    )
+    return (
+        numpy.array(hashes, numpy.uint64),
+        numpy.array(status, numpy.int32),
+        numpy.array(groups, numpy.int64),
+    )
+
+
+def find_duplicates(filenames, **kwargs):
+    _, _, groups = content_hashes(filenames, **kwargs)
+    members = {}
+    for i, g in enumerate(groups):
+        if g >= 0:
+            members.setdefault(g, []).append(i)
+    return [m for m in members.values() if len(m) > 1]
+
+
+def minhash_signatures(
+    filenames,
+    ngram = 4,
+    resolution = 12,
+    bands = 16,
+    rows = 8,
+    seed = 0,
+    threads = 0,
+):
+    signatures, status = _ext.minhash_signatures(
+        [str(f) for f in filenames],
+        ngram=ngram,
+        resolution=resolution,
+        bands=bands,
+        rows=rows,
+        seed=seed,
+        threads=threads,
+    )
+    return signatures, numpy.array(status, numpy.int32)
+
+
+def near_duplicates(signatures, bands=16, rows=8, threshold=0.8, threads=0):
+    a, b, similarity = _ext.lsh_pairs(
+        numpy.ascontiguousarray(signatures, numpy.uint32),
+        bands=bands,
+        rows=rows,
+        threshold=threshold,
+        threads=threads,
+    )
+    return (
+        numpy.array(a, numpy.int64),
+        numpy.array(b, numpy.int64),
+        numpy.array(similarity, numpy.float32),
+    )
+
+
+def corpus_stats(filenames, default_program=0, threads=0):
+    stats = _ext.corpus_stats(
+        [str(f) for f in filenames],
+        default_program=default_program,
+        threads=threads,
+    )
+    out = dict(files=stats.pop('files'), failed=stats.pop('failed'))
+    for name, (counts, lo, width) in stats.items():
+        counts = numpy.array(counts, numpy.int64)
+        edges = lo + width * numpy.arange(len(counts) + 1)
+        out[name] = counts, edges
+    return out
+
+
+def _event_rows(events):
+    events = numpy.ascontiguousarray(events)
+    return events.view(numpy.uint8).reshape(len(events), TRACK_DTYPE.itemsize)
+
+
+def tokenize_midi_like(
+    filenames,
+    steps_per_second = 100,
+    max_shift = 100,
+    velocity_bins = 32,
+    programs = False,
+    default_program = 0,
+    threads = 0,
+):
+    tokens, offsets, status = _ext.tokenize_midi_like(
+        [str(f) for f in filenames],
+        steps_per_second=steps_per_second,
+        max_shift=max_shift,
+        velocity_bins=velocity_bins,
+        programs=programs,
+        default_program=default_program,
+        threads=threads,
+    )
+    return (
+        tokens,
+        numpy.array(offsets, numpy.int64),
+        numpy.array(status, numpy.int32),
+    )
+
+
+def events_to_midi_like(
+    events,
+    steps_per_second = 100,
+    max_shift = 100,
+    velocity_bins = 32,
+    programs = False,
+):
+    return _ext.events_to_midi_like(
+        _event_rows(events),
+        steps_per_second=steps_per_second,
+        max_shift=max_shift,
+        velocity_bins=velocity_bins,
+        programs=programs,
+    )
+
+
+def tokenize_remi(
+    filenames,
+    steps_per_beat = 4,
+    max_bar = 32,
+    max_duration = 32,
+    velocity_bins = 32,
+    tempo_bins = 32,
+    min_bpm = 40,
+    max_bpm = 250,
+    programs = False,
+    bar_lengths = False,
+    default_program = 0,
+    threads = 0,
+):
+    tokens, offsets, status = _ext.tokenize_remi(
+        [str(f) for f in filenames],
+        steps_per_beat=steps_per_beat,
+        max_bar=max_bar,
+        max_duration=max_duration,
+        velocity_bins=velocity_bins,
+        tempo_bins=tempo_bins,
+        min_bpm=min_bpm,
+        max_bpm=max_bpm,
+        programs=programs,
+        bar_lengths=bar_lengths,
+        default_program=default_program,
+        threads=threads,
+    )
+    return (
+        tokens,
+        numpy.array(offsets, numpy.int64),
+        numpy.array(status, numpy.int32),
+    )
+
+
+OCTUPLE_FIELDS = (
+    'bar',
+    'position',
+    'pitch',
+    'duration',
+    'velocity',
+    'program',
+    'tempo',
+    'time_signature',
+)
+
+
+def tokenize_octuple(
+    filenames,
+    steps_per_beat = 4,
+    max_bar = 32,
+    max_duration = 32,
+    velocity_bins = 32,
+    tempo_bins = 32,
+    min_bpm = 40,
+    max_bpm = 250,
+    default_program = 0,
+    threads = 0,
+):
+    tokens, offsets, status = _ext.tokenize_octuple(
+        [str(f) for f in filenames],
+        steps_per_beat=steps_per_beat,
+        max_bar=max_bar,
+        max_duration=max_duration,
+        velocity_bins=velocity_bins,
+        tempo_bins=tempo_bins,
+        min_bpm=min_bpm,
+        max_bpm=max_bpm,
+        default_program=default_program,
+        threads=threads,
+    )
+    return (
+        tokens.reshape(-1, len(OCTUPLE_FIELDS)),
+        numpy.array(offsets, numpy.int64),
+        numpy.array(status, numpy.int32),
+    )
+
+
+def _events_view(x):
+    return x.view(TRACK_DTYPE)[:, 0].view(numpy.recarray)
+
+
+def _midi_files(data, offsets, filenames):
+    files = [data[offsets[i]:offsets[i+1]].tobytes() for i in range(len(offsets) - 1)]
+    if filenames is not None:
+        if len(filenames) != len(files):
+            raise ValueError(f'{len(files)} files but {len(filenames)} filenames')
+        for name, f in zip(filenames, files):
+            with open(name, 'wb') as out:
+                out.write(f)
+    return files
+
+
+def _offsets(tokens, offsets):
+    if offsets is None:
+        offsets = [0, len(tokens)]
+    return numpy.ascontiguousarray(offsets, numpy.int64)
+
+
+def midi_like_to_events(
+    tokens,
+    steps_per_second = 100,
+    max_shift = 100,
+    velocity_bins = 32,
+    programs = False,
+    default_program = 0,
+):
+    return _events_view(_ext.midi_like_to_events(
+        numpy.ascontiguousarray(tokens, numpy.int32),
+        steps_per_second=steps_per_second,
+        max_shift=max_shift,
+        velocity_bins=velocity_bins,
+        programs=programs,
+        default_program=default_program,
+    ))
+
+
+def midi_like_to_midi(
+    tokens,
+    offsets = None,
+    filenames = None,
+    steps_per_second = 100,
+    max_shift = 100,
+    velocity_bins = 32,
+    programs = False,
+    default_program = 0,
+    threads = 0,
+):
+    data, starts = _ext.midi_like_to_midi(
+        numpy.ascontiguousarray(tokens, numpy.int32),
+        _offsets(tokens, offsets),
+        steps_per_second=steps_per_second,
+        max_shift=max_shift,
+        velocity_bins=velocity_bins,
+        programs=programs,
+        default_program=default_program,
+        threads=threads,
+    )
+    return _midi_files(data, starts, filenames)
+
+
+def remi_to_events(
+    tokens,
+    steps_per_beat = 4,
+    max_bar = 32,
+    max_duration = 32,
+    velocity_bins = 32,
+    tempo_bins = 32,
+    min_bpm = 40,
+    max_bpm = 250,
+    programs = False,
+    bar_lengths = False,
+    default_program = 0,
+):
+    return _events_view(_ext.remi_to_events(
+        numpy.ascontiguousarray(tokens, numpy.int32),
+        steps_per_beat=steps_per_beat,
+        max_bar=max_bar,
+        max_duration=max_duration,
+        velocity_bins=velocity_bins,
+        tempo_bins=tempo_bins,
+        min_bpm=min_bpm,
+        max_bpm=max_bpm,
+        programs=programs,
+        bar_lengths=bar_lengths,
+        default_program=default_program,
+    ))
+
+
+def remi_to_midi(
+    tokens,
+    offsets = None,
+    filenames = None,
+    steps_per_beat = 4,
+    max_bar = 32,
+    max_duration = 32,
+    velocity_bins = 32,
+    tempo_bins = 32,
+    min_bpm = 40,
+    max_bpm = 250,
+    programs = False,
+    bar_lengths = False,
+    default_program = 0,
+    threads = 0,
+):
+    data, starts = _ext.remi_to_midi(
+        numpy.ascontiguousarray(tokens, numpy.int32),
+        _offsets(tokens, offsets),
+        steps_per_beat=steps_per_beat,
+        max_bar=max_bar,
+        max_duration=max_duration,
+        velocity_bins=velocity_bins,
+        tempo_bins=tempo_bins,
+        min_bpm=min_bpm,
+        max_bpm=max_bpm,
+        programs=programs,
+        bar_lengths=bar_lengths,
+        default_program=default_program,
+        threads=threads,
+    )
+    return _midi_files(data, starts, filenames)
+
+
+def octuple_to_events(
+    tokens,
+    steps_per_beat = 4,
+    max_bar = 32,
+    max_duration = 32,
+    velocity_bins = 32,
+    tempo_bins = 32,
+    min_bpm = 40,
+    max_bpm = 250,
+):
+    return _events_view(_ext.octuple_to_events(
+        numpy.ascontiguousarray(tokens, numpy.int16).reshape(-1, len(OCTUPLE_FIELDS)),
+        steps_per_beat=steps_per_beat,
+        max_bar=max_bar,
+        max_duration=max_duration,
+        velocity_bins=velocity_bins,
+        tempo_bins=tempo_bins,
+        min_bpm=min_bpm,
+        max_bpm=max_bpm,
+    ))
+
+
+def octuple_to_midi(
+    tokens,
+    offsets = None,
+    filenames = None,
+    steps_per_beat = 4,
+    max_bar = 32,
+    max_duration = 32,
+    velocity_bins = 32,
+    tempo_bins = 32,
+    min_bpm = 40,
+    max_bpm = 250,
+    threads = 0,
+):
+    data, starts = _ext.octuple_to_midi(
+        numpy.ascontiguousarray(tokens, numpy.int16).reshape(-1, len(OCTUPLE_FIELDS)),
+        _offsets(tokens, offsets),
+        steps_per_beat=steps_per_beat,
+        max_bar=max_bar,
+        max_duration=max_duration,
+        velocity_bins=velocity_bins,
+        tempo_bins=tempo_bins,
+        min_bpm=min_bpm,
+        max_bpm=max_bpm,
+        threads=threads,
+    )
+    return _midi_files(data, starts, filenames)
+
+
+class BPE:
+    def __init__(self, base, merges):
+        merges = numpy.ascontiguousarray(merges, numpy.int32).reshape(-1, 2)
+        self._bpe = _ext.Bpe(base, merges)
+
+    @classmethod
+    def train(cls, tokens, offsets=None, base=None, vocab_size=1024, min_count=2, threads=0):
+        tokens = numpy.ascontiguousarray(tokens, numpy.int32)
+        if base is None:
+            base = int(tokens.max(initial=-1)) + 1
+        self = cls.__new__(cls)
+        self._bpe = _ext.train_bpe(
+            tokens,
+            _offsets(tokens, offsets),
+            base=base,
+            vocab_size=vocab_size,
+            min_count=min_count,
+            threads=threads,
+        )
+        return self
+
+    def save(self, filename):
+        numpy.savez(filename, base=self.base, merges=self.merges)
+
+    @classmethod
+    def load(cls, filename):
+        with numpy.load(filename) as f:
+            return cls(int(f['base']), f['merges'])
+
+    @property
+    def base(self):
+        return self._bpe.base
+
+    @property
+    def merges(self):
+        return self._bpe.merges
+
+    @property
+    def vocab_size(self):
+        return self._bpe.vocab_size
+
+    def _apply(self, fn, tokens, offsets, threads):
+        tokens = numpy.ascontiguousarray(tokens, numpy.int32)
+        out, starts, _ = fn(tokens, _offsets(tokens, offsets), threads=threads)
+        if offsets is None:
+            return out
+        return out, numpy.array(starts, numpy.int64)
+
+    def encode(self, tokens, offsets=None, threads=0):
+        return self._apply(self._bpe.encode, tokens, offsets, threads)
+
+    def decode(self, tokens, offsets=None, threads=0):
+        return self._apply(self._bpe.decode, tokens, offsets, threads)
+
+
+def _roll(data, groups, group):
+    if data.shape[1] == 1:
+        data = data[:, 0]
+    if group is None:
+        return data[0]
+    return data, numpy.array(groups, numpy.int32)
+
+
+def pianoroll(
+    events,
+    fps = 100,
+    velocity = False,
+    onsets = False,
+    offsets = False,
+    sustain = True,
+    packed = False,
+    group = None,
+    frames = 0,
+):
+    data, groups = _ext.pianoroll(
+        _event_rows(events),
+        fps=fps,
+        velocity=velocity,
+        onsets=onsets,
+        offsets=offsets,
+        sustain=sustain,
+        packed=packed,
+        group=group or 'none',
+        frames=frames,
+    )
+    return _roll(data, groups, group)
+
+
+def pianoroll_batch(
+    filenames,
+    fps = 100,
+    velocity = False,
+    onsets = False,
+    offsets = False,
+    sustain = True,
+    packed = False,
+    group = None,
+    frames = 0,
+    default_program = 0,
+    threads = 0,
+):
+    rolls, status = _ext.pianoroll_batch(
+        [str(f) for f in filenames],
+        fps=fps,
+        velocity=velocity,
+        onsets=onsets,
+        offsets=offsets,
+        sustain=sustain,
+        packed=packed,
+        group=group or 'none',
+        frames=frames,
+        default_program=default_program,
+        threads=threads,
+    )
+    rolls = [_roll(data, groups, group) for data, groups in rolls]
+    if frames and group is None:
+        rolls = numpy.stack(rolls)
+    return rolls, numpy.array(status, numpy.int32)
+
+
+def _sparse_roll(indices, values, frames, groups, group, channels):
+    keep = [group is not None, channels > 1, True, True]
+    shape = [len(groups), channels, frames, 128]
+    indices = indices[keep]
+    shape = tuple(s for s, k in zip(shape, keep) if k)
+    if group is None:
+        return indices, values, shape
+    return indices, values, shape, numpy.array(groups, numpy.int32)
+
+
+def sparse_pianoroll(
+    events,
+    fps = 100,
+    velocity = False,
+    onsets = False,
+    offsets = False,
+    sustain = True,
+    group = None,
+    frames = 0,
+):
+    indices, values, length, groups = _ext.sparse_pianoroll(
+        _event_rows(events),
+        fps=fps,
+        velocity=velocity,
+        onsets=onsets,
+        offsets=offsets,
+        sustain=sustain,
+        packed=False,
+        group=group or 'none',
+        frames=frames,
+    )
+    channels = 1 + onsets + offsets
+    return _sparse_roll(indices, values, length, groups, group, channels)
+
+
+def sparse_pianoroll_batch(
+    filenames,
+    fps = 100,
+    velocity = False,
+    onsets = False,
+    offsets = False,
+    sustain = True,
+    group = None,
+    frames = 0,
+    default_program = 0,
+    threads = 0,
+):
+    rolls, status = _ext.sparse_pianoroll_batch(
+        [str(f) for f in filenames],
+        fps=fps,
+        velocity=velocity,
+        onsets=onsets,
+        offsets=offsets,
+        sustain=sustain,
+        packed=False,
+        group=group or 'none',
+        frames=frames,
+        default_program=default_program,
+        threads=threads,
+    )
+    channels = 1 + onsets + offsets
+    rolls = [_sparse_roll(*r, group, channels) for r in rolls]
+    return rolls, numpy.array(status, numpy.int32)
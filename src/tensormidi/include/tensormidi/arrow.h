@@ -0,0 +1,193 @@
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "tensormidi.h"
+#include "columns.h"
+
+// Arrow C Data Interface, as specified by
+// https://arrow.apache.org/docs/format/CDataInterface.html
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+extern "C" {
+
+struct ArrowSchema
+{
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+    void (*release)(struct ArrowSchema*);
+    void* private_data;
+};
+
+struct ArrowArray
+{
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+    void (*release)(struct ArrowArray*);
+    void* private_data;
+};
+
+} // extern "C"
+
+#endif // ARROW_C_DATA_INTERFACE
+
+namespace tensormidi {
+
+namespace arrow {
+
+struct SchemaNode
+{
+    std::string format;
+    std::string name;
+    std::vector<ArrowSchema> children;
+    std::vector<ArrowSchema*> child_ptrs;
+};
+
+inline void release_schema(ArrowSchema * s)
+{
+    for(int64_t i=0 ; i<s->n_children ; i++)
+        if(s->children[i]->release) { s->children[i]->release(s->children[i]); }
+    delete (SchemaNode *) s->private_data;
+    s->release = nullptr;
+}
+
+// fills out and returns its node, whose children the caller then fills
+inline SchemaNode * init_schema(ArrowSchema * out, 
+    char const* format, char const* name, size_t n_children)
+{
+    SchemaNode * node = new SchemaNode { format, name, 
+        std::vector<ArrowSchema>(n_children), {} };
+    for(ArrowSchema & c : node->children) { node->child_ptrs.push_back(&c); }
+    *out = ArrowSchema {};
+    out->format = node->format.c_str();
+    out->name = node->name.c_str();
+    out->n_children = n_children;
+    out->children = n_children ? node->child_ptrs.data() : nullptr;
+    out->release = release_schema;
+    out->private_data = node;
+    return node;
+}
+
+struct ArrayNode
+{
+    std::shared_ptr<void const> owner;
+    std::vector<void const*> buffers;
+    std::vector<ArrowArray> children;
+    std::vector<ArrowArray*> child_ptrs;
+};
+
+inline void release_array(ArrowArray * a)
+{
+    for(int64_t i=0 ; i<a->n_children ; i++)
+        if(a->children[i]->release) { a->children[i]->release(a->children[i]); }
+    delete (ArrayNode *) a->private_data;
+    a->release = nullptr;
+}
+
+// buffers[0] is always the (absent) validity bitmap, arrays here have no nulls
+inline ArrayNode * init_array(ArrowArray * out, 
+    std::shared_ptr<void const> owner, int64_t length,
+    std::vector<void const*> buffers, size_t n_children)
+{
+    ArrayNode * node = new ArrayNode { std::move(owner), std::move(buffers), 
+        std::vector<ArrowArray>(n_children), {} };
+    for(ArrowArray & c : node->children) { node->child_ptrs.push_back(&c); }
+    *out = ArrowArray {};
+    out->length = length;
+    out->n_buffers = node->buffers.size();
+    out->buffers = node->buffers.data();
+    out->n_children = n_children;
+    out->children = n_children ? node->child_ptrs.data() : nullptr;
+    out->release = release_array;
+    out->private_data = node;
+    return node;
+}
+
+} // namespace arrow
+
+// A batch of files as an Arrow record batch with one row per file and a single 
+// column, events: large_list<struct<time, track, program, ...>>. The event 
+// fields are flat contiguous columns and the list offsets are file boundaries,
+// so consumers can flatten to one event table without copying.
+// Exports share the column memory and keep it alive until released.
+struct EventTable
+{
+    struct Data
+    {
+        Columns<double> columns;
+        std::vector<int64_t> offsets {0};
+    };
+    std::shared_ptr<Data> data = std::make_shared<Data>();
+
+    EventTable() {}
+
+    EventTable(std::vector<File> const& files)
+    {
+        for(File const& f : files) { add_row(f); }
+    }
+
+    size_t rows() const { return data->offsets.size() - 1; }
+
+    // all tracks of f go into one row, back to back
+    EventTable & add_row(File const& f)
+    {
+        for(Track const& t : f.tracks)
+        {
+            Event const* e = t.events.data();
+            data->columns.append(e, e + t.events.size());
+        }
+        data->offsets.push_back(data->columns.size());
+        return *this;
+    }
+
+    void export_schema(ArrowSchema * out) const
+    {
+        arrow::SchemaNode * batch = arrow::init_schema(out, "+s", "", 1);
+        arrow::SchemaNode * list = arrow::init_schema(
+            &batch->children[0], "+L", "events", 1);
+        arrow::SchemaNode * event = arrow::init_schema(
+            &list->children[0], "+s", "item", 7);
+        char const* names[7] = {
+            "time", "track", "program", "channel", "type", "key", "value" };
+        for(int i=0 ; i<7 ; i++)
+            arrow::init_schema(&event->children[i], i ? "C" : "g", names[i], 0);
+    }
+
+    void export_array(ArrowArray * out) const
+    {
+        Columns<double> const& c = data->columns;
+        int64_t n = c.size();
+        arrow::ArrayNode * batch = arrow::init_array(
+            out, data, rows(), { nullptr }, 1);
+        arrow::ArrayNode * list = arrow::init_array(
+            &batch->children[0], data, rows(), 
+            { nullptr, data->offsets.data() }, 1);
+        arrow::ArrayNode * event = arrow::init_array(
+            &list->children[0], data, n, { nullptr }, 7);
+        void const* fields[7] = { c.time.data(), c.track.data(), 
+            c.program.data(), c.channel.data(), c.type.data(), 
+            c.key.data(), c.value.data() };
+        for(int i=0 ; i<7 ; i++)
+            arrow::init_array(&event->children[i], data, n, 
+                { nullptr, fields[i] }, 0);
+    }
+};
+
+} // namespace tensormidi
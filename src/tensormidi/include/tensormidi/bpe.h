@@ -0,0 +1,251 @@
+#pragma once
+
+#include <queue>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+#include "tensormidi/parallel.h"
+#include "tensormidi/tokenize.h"
+
+namespace tensormidi {
+
+// Apply fn(int32_t const* in, size_t n, std::vector<int32_t> & out) to each
+// of n ragged sequences in parallel and pack the results
+template<class Fn>
+Ragged<int32_t> transform_batch(int32_t const* tokens, int64_t const* offsets,
+    size_t n, int threads, Fn && fn)
+{
+    std::vector<std::vector<int32_t>> parts(n);
+    parallel_for(n, threads, [&] (size_t i, int) {
+        (offsets[i] >= 0 && offsets[i] <= offsets[i+1]) || err("offsets must be ascending");
+        fn(tokens + offsets[i], offsets[i+1] - offsets[i], parts[i]);
+    });
+    Ragged<int32_t> out;
+    out.status.resize(n);
+    out.offsets.push_back(0);
+    for(auto & p : parts)
+    {
+        out.values.insert(out.values.end(), p.begin(), p.end());
+        out.offsets.push_back(out.values.size());
+        std::vector<int32_t>().swap(p);
+    }
+    return out;
+}
+
+// Byte pair encoding over token ids. Merge i joins a pair of tokens into the
+// new token base + i. Encoding applies merges lowest first, leftmost first
+// among equals, which reproduces how training rewrote its corpus.
+struct Bpe
+{
+    using Pair = std::pair<int32_t, int32_t>;
+
+    int32_t base = 0; // tokens below are not merged
+    std::vector<Pair> merges;
+    std::unordered_map<uint64_t, int32_t> ranks;
+
+    static uint64_t key(int32_t a, int32_t b) { return uint64_t(uint32_t(a)) << 32 | uint32_t(b); }
+
+    Bpe() {}
+
+    Bpe(int32_t base, std::vector<Pair> merges)
+    :   base(base),
+        merges(std::move(merges))
+    {
+        base >= 0 || err("base must not be negative");
+        for(size_t i=0 ; i<this->merges.size() ; i++)
+        {
+            auto [a, b] = this->merges[i];
+            (a >= 0 && b >= 0 && a < base + int64_t(i) && b < base + int64_t(i))
+                || err("merges may only join earlier tokens");
+            ranks.emplace(key(a, b), i);
+        }
+    }
+
+    int32_t vocab_size() const { return base + merges.size(); }
+
+    void encode(int32_t const* in, size_t n, std::vector<int32_t> & out) const
+    {
+        out.assign(in, in + n);
+        thread_local std::vector<int64_t> next, prev;
+        next.resize(n);
+        prev.resize(n);
+        for(size_t i=0 ; i<n ; i++)
+        {
+            next[i] = i+1 < n ? i+1 : -1;
+            prev[i] = int64_t(i) - 1;
+        }
+        // (rank, position) of candidate merges, stale ones are skipped
+        using Candidate = std::pair<int32_t, int64_t>;
+        std::priority_queue<Candidate, std::vector<Candidate>, std::greater<Candidate>> heap;
+        auto offer = [&] (int64_t i) {
+            if(i < 0 || next[i] < 0) { return; }
+            auto it = ranks.find(key(out[i], out[next[i]]));
+            if(it != ranks.end()) { heap.push({ it->second, i }); }
+        };
+        for(size_t i=0 ; i+1<n ; i++) { offer(i); }
+
+        while(heap.size())
+        {
+            auto [rank, i] = heap.top();
+            heap.pop();
+            int64_t j = next[i];
+            if(out[i] < 0 || j < 0 || merges[rank] != Pair { out[i], out[j] }) { continue; }
+            out[i] = base + rank;
+            out[j] = -1;
+            next[i] = next[j];
+            if(next[j] >= 0) { prev[next[j]] = i; }
+            offer(prev[i]);
+            offer(i);
+        }
+        out.erase(std::remove(out.begin(), out.end(), -1), out.end());
+    }
+
+    void decode(int32_t const* in, size_t n, std::vector<int32_t> & out) const
+    {
+        out.clear();
+        thread_local std::vector<int32_t> stack;
+        for(size_t i=0 ; i<n ; i++)
+        {
+            (in[i] >= 0 && in[i] < vocab_size()) || err("token out of range");
+            stack.assign(1, in[i]);
+            while(stack.size())
+            {
+                int32_t t = stack.back();
+                stack.pop_back();
+                if(t < base) { out.push_back(t); continue; }
+                stack.push_back(merges[t - base].second);
+                stack.push_back(merges[t - base].first);
+            }
+        }
+    }
+
+    Ragged<int32_t> encode_batch(int32_t const* tokens, int64_t const* offsets,
+        size_t n, int threads = 0) const
+    {
+        return transform_batch(tokens, offsets, n, threads,
+            [&] (int32_t const* in, size_t count, std::vector<int32_t> & out) {
+                encode(in, count, out);
+            });
+    }
+
+    Ragged<int32_t> decode_batch(int32_t const* tokens, int64_t const* offsets,
+        size_t n, int threads = 0) const
+    {
+        return transform_batch(tokens, offsets, n, threads,
+            [&] (int32_t const* in, size_t count, std::vector<int32_t> & out) {
+                decode(in, count, out);
+            });
+    }
+};
+
+// Learn merges until vocab_size or until no pair occurs min_count times.
+// Pairs are counted in parallel over contiguous runs of sequences, then each
+// merge only visits the occurrences of its pair and updates the counts of
+// their neighbours. Ties go to the smaller pair, so training is deterministic.
+inline Bpe train_bpe(int32_t const* tokens, int64_t const* offsets, size_t n,
+    int32_t base, int32_t vocab_size, int64_t min_count = 2, int threads = 0)
+{
+    vocab_size >= base || err("vocab_size must be at least base");
+    int64_t first = n ? offsets[0] : 0;
+    int64_t size = n ? offsets[n] - first : 0;
+    (first >= 0 && size >= 0) || err("offsets must be ascending");
+    std::vector<int32_t> t(tokens + first, tokens + first + size);
+    std::vector<int64_t> next(size), prev(size);
+
+    struct Count
+    {
+        int64_t count = 0;
+        std::vector<int64_t> at; // ascending, may hold stale positions
+    };
+    using Counts = std::unordered_map<uint64_t, Count>;
+
+    int chunks = thread_count(threads, n);
+    std::vector<Counts> partial(chunks);
+    parallel_for(chunks, threads, [&] (size_t c, int) {
+        for(size_t s = n * c / chunks ; s < n * (c+1) / chunks ; s++)
+        {
+            int64_t b = offsets[s] - first, e = offsets[s+1] - first;
+            (b >= 0 && b <= e && e <= size) || err("offsets must be ascending");
+            for(int64_t i=b ; i<e ; i++)
+            {
+                (t[i] >= 0 && t[i] < base) || err("token out of range");
+                next[i] = i+1 < e ? i+1 : -1;
+                prev[i] = i > b ? i-1 : -1;
+                if(i+1 < e) { partial[c][Bpe::key(t[i], t[i+1])].at.push_back(i); }
+            }
+        }
+    });
+    Counts pairs;
+    for(Counts & p : partial)
+    {
+        for(auto & [k, c] : p)
+        {
+            Count & to = pairs[k];
+            to.at.insert(to.at.end(), c.at.begin(), c.at.end());
+            to.count += c.at.size();
+        }
+        Counts().swap(p);
+    }
+
+    // most frequent first, then the smaller pair
+    using Entry = std::pair<int64_t, uint64_t>;
+    auto order = [] (Entry const& a, Entry const& b) {
+        return a.first < b.first || (a.first == b.first && a.second > b.second);
+    };
+    std::priority_queue<Entry, std::vector<Entry>, decltype(order)> heap { order };
+    for(auto const& [k, c] : pairs) { heap.push({ c.count, k }); }
+
+    std::vector<Bpe::Pair> merges;
+    std::vector<uint64_t> changed;
+    while(base + int64_t(merges.size()) < vocab_size && heap.size())
+    {
+        auto [count, k] = heap.top();
+        heap.pop();
+        auto it = pairs.find(k);
+        if(it == pairs.end() || it->second.count != count) { continue; }
+        if(count < min_count) { break; }
+
+        int32_t a = k >> 32, b = uint32_t(k);
+        int32_t id = base + merges.size();
+        merges.push_back({ a, b });
+        std::vector<int64_t> at = std::move(it->second.at);
+        pairs.erase(it);
+
+        changed.clear();
+        auto add = [&] (int32_t x, int32_t y, int64_t d, int64_t i) {
+            uint64_t kk = Bpe::key(x, y);
+            if(kk == k) { return; }
+            Count & c = pairs[kk];
+            c.count += d;
+            if(d > 0) { c.at.push_back(i); }
+            changed.push_back(kk);
+        };
+        for(int64_t i : at)
+        {
+            int64_t j = next[i];
+            if(t[i] != a || j < 0 || t[j] != b) { continue; }
+            int64_t p = prev[i], q = next[j];
+            if(p >= 0) { add(t[p], a, -1, p); }
+            if(q >= 0) { add(b, t[q], -1, j); }
+            t[i] = id;
+            t[j] = -1;
+            next[i] = q;
+            if(q >= 0) { prev[q] = i; }
+            if(p >= 0) { add(t[p], id, 1, p); }
+            if(q >= 0) { add(id, t[q], 1, i); }
+        }
+        std::sort(changed.begin(), changed.end());
+        changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+        for(uint64_t kk : changed)
+        {
+            auto c = pairs.find(kk);
+            if(c->second.count <= 0) { pairs.erase(c); }
+            else { heap.push({ c->second.count, kk }); }
+        }
+    }
+    return Bpe { base, std::move(merges) };
+}
+
+} // namespace tensormidi
@@ -0,0 +1,132 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+
+#include "tensormidi.h"
+
+namespace tensormidi {
+
+// .tmidi is a parsed file dumped as-is, so loading is a mmap and some pointer
+// math. Native byte order, every section starts 64 byte aligned:
+//   CacheHeader | Tempo[n_tempos] | uint64 track_ends[n_tracks] | Event[n_events]
+// Track i holds events [track_ends[i-1], track_ends[i]).
+struct CacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t time_unit; // Options::TimeUnit
+    uint32_t merged;
+    int32_t type;
+    int32_t ticks_per_beat;
+    int32_t steps_per_beat;
+    uint32_t n_tracks;
+    uint64_t n_tempos;
+    uint64_t n_events;
+    uint64_t tempo_offset;
+    uint64_t track_offset;
+    uint64_t event_offset;
+    uint32_t notes_only; // 0 unknown (saved arrays, older files), 1 notes only, 2 all events
+    int32_t default_program; // parse option, when notes_only is known
+
+    static constexpr char const* MAGIC = "TMID";
+    static constexpr uint32_t VERSION = 1;
+    static constexpr size_t ALIGN = 64;
+
+    static uint64_t align(uint64_t x) { return (x + ALIGN-1) / ALIGN * ALIGN; }
+};
+
+static_assert(sizeof(CacheHeader) == 80, "CacheHeader layout");
+
+// serialize f, whose times are in the given unit, to a .tmidi image.
+// parsed records that f came from parse_file with opt, not from arrays.
+inline std::string encode_cache(File const& f, Options const& opt, bool parsed = true)
+{
+    CacheHeader head {};
+    std::memcpy(head.magic, CacheHeader::MAGIC, 4);
+    head.version = CacheHeader::VERSION;
+    head.time_unit = opt.time_unit;
+    head.merged = opt.merge_tracks;
+    head.type = f.type;
+    head.ticks_per_beat = f.ticks_per_beat;
+    head.steps_per_beat = opt.steps_per_beat;
+    head.notes_only = parsed ? 2 - opt.notes_only : 0;
+    head.default_program = parsed ? opt.default_program : 0;
+    head.n_tracks = f.tracks.size();
+    head.n_tempos = f.tempos.size();
+    for(Track const& t : f.tracks) { head.n_events += t.events.size(); }
+
+    head.tempo_offset = CacheHeader::align(sizeof(CacheHeader));
+    head.track_offset = CacheHeader::align(
+        head.tempo_offset + head.n_tempos * sizeof(Tempo));
+    head.event_offset = CacheHeader::align(
+        head.track_offset + head.n_tracks * sizeof(uint64_t));
+    size_t size = head.event_offset + head.n_events * sizeof(Event);
+
+    std::string out(size, '\0');
+    char * base = &out[0];
+    std::memcpy(base, &head, sizeof(head));
+    std::copy(f.tempos.begin(), f.tempos.end(), 
+        (Tempo *)(base + head.tempo_offset));
+    uint64_t * track_end = (uint64_t *)(base + head.track_offset);
+    Event * events = (Event *)(base + head.event_offset);
+    uint64_t n = 0;
+    for(Track const& t : f.tracks)
+    {
+        std::copy(t.events.begin(), t.events.end(), events + n);
+        n += t.events.size();
+        *track_end++ = n;
+    }
+    return out;
+}
+
+inline void write_cache(std::string const& path, File const& f, Options const& opt, 
+    bool parsed = true)
+{
+    std::string data = encode_cache(f, opt, parsed);
+    std::ofstream file(path, std::ios::binary);
+    file.write(data.data(), data.size());
+    file || err("can't write file");
+}
+
+// Zero-copy view of a .tmidi image, validated against its size.
+// data must stay alive (and 8 byte aligned) as long as the view is used.
+struct CacheView
+{
+    CacheHeader const* head = nullptr;
+    Tempo const* tempos = nullptr;
+    uint64_t const* track_ends = nullptr;
+    Event * events = nullptr;
+
+    CacheView() {}
+
+    CacheView(u8 * data, size_t size)
+    {
+        size >= sizeof(CacheHeader) || err("short cache");
+        head = (CacheHeader const*) data;
+        std::memcmp(head->magic, CacheHeader::MAGIC, 4) == 0 || err("not a tmidi cache");
+        head->version == CacheHeader::VERSION || err("unsupported tmidi version");
+
+        auto fits = [&] (uint64_t offset, uint64_t count, size_t item) {
+            return offset <= size && count <= (size - offset) / item;
+        };
+        (fits(head->tempo_offset, head->n_tempos, sizeof(Tempo)) &&
+        fits(head->track_offset, head->n_tracks, sizeof(uint64_t)) &&
+        fits(head->event_offset, head->n_events, sizeof(Event))) ||
+            err("truncated cache");
+
+        tempos = (Tempo const*)(data + head->tempo_offset);
+        track_ends = (uint64_t const*)(data + head->track_offset);
+        events = (Event *)(data + head->event_offset);
+        for(uint32_t i=0 ; i<head->n_tracks ; i++)
+            (track_ends[i] <= head->n_events && track_begin(i) <= track_ends[i]) 
+                || err("bad track table");
+    }
+
+    size_t n_tracks() const { return head->n_tracks; }
+    size_t track_begin(size_t i) const { return i ? track_ends[i-1] : 0; }
+    size_t track_size(size_t i) const { return track_ends[i] - track_begin(i); }
+    Event * track(size_t i) const { return events + track_begin(i); }
+};
+
+} // namespace tensormidi
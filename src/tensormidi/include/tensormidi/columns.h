@@ -0,0 +1,55 @@
+#pragma once
+
+#include "tensormidi.h"
+
+namespace tensormidi {
+
+// Struct-of-arrays copy of an event run, one contiguous array per field.
+// Frameworks that can't consume the interleaved Event layout (torch, jax,
+// arrow) take these without another conversion on their side.
+template<class Time=double>
+struct Columns
+{
+    std::vector<Time> time;
+    std::vector<u8> track;
+    std::vector<u8> program;
+    std::vector<u8> channel;
+    std::vector<u8> type;
+    std::vector<u8> key;
+    std::vector<u8> value;
+
+    Columns() {}
+
+    Columns(Event const* begin, Event const* end)
+    {
+        append(begin, end);
+    }
+
+    size_t size() const { return time.size(); }
+
+    Columns & append(Event const* begin, Event const* end)
+    {
+        size_t n = size();
+        size_t m = n + (end - begin);
+        time.resize(m);
+        track.resize(m);
+        program.resize(m);
+        channel.resize(m);
+        type.resize(m);
+        key.resize(m);
+        value.resize(m);
+        for(Event const* e = begin ; e != end ; e++, n++)
+        {
+            time[n] = Time(e->time);
+            track[n] = e->track;
+            program[n] = e->program;
+            channel[n] = e->channel;
+            type[n] = e->type;
+            key[n] = e->key;
+            value[n] = e->value;
+        }
+        return *this;
+    }
+};
+
+} // namespace tensormidi
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+#include "tensormidi/hash.h"
+#include "tensormidi/io.h"
+#include "tensormidi/notes.h"
+#include "tensormidi/parallel.h"
+
+namespace tensormidi {
+
+struct DedupOptions
+{
+    int resolution = 960; // grid steps per beat the note times snap to
+    bool ignore_program = false; // also drops channels
+    bool velocity = false; // tell apart notes by velocity too
+};
+
+// Hash of what the notes are, not how the file spells them. Tracks are merged,
+// times go to a fixed resolution in beats starting at the first onset, so
+// ticks per beat, tempo meta, track order and leading silence all drop out.
+// Files without notes all hash alike, n_notes tells them apart.
+inline uint64_t content_hash(Stream src, DedupOptions const& opt = {}, size_t * n_notes = nullptr)
+{
+    Options parse;
+    parse.time_unit = Options::TICKS;
+    File f = parse_file(src, parse);
+    std::vector<Event> const& events = f.tracks[0].events;
+    double steps = double(opt.resolution) / std::max(1, f.ticks_per_beat);
+
+    thread_local std::vector<Note> notes;
+    pair_notes(events.data(), events.data() + events.size(), notes);
+    if(n_notes) { *n_notes = notes.size(); }
+    double first = notes.size() ? notes[0].start : 0;
+
+    thread_local std::vector<std::pair<uint64_t, uint64_t>> words;
+    words.clear();
+    for(Note const& n : notes)
+    {
+        uint64_t start = std::llround((n.start - first) * steps);
+        uint64_t length = std::llround((n.end - n.start) * steps);
+        uint64_t voice = opt.ignore_program ? 0 : n.program << 4 | n.channel;
+        uint64_t velocity = opt.velocity ? n.velocity : 0;
+        words.push_back({ start << 25 | voice << 14 | velocity << 7 | n.key, length });
+    }
+    // order of simultaneous notes is arbitrary in the file
+    std::sort(words.begin(), words.end());
+    return hash_bytes(words.data(), words.size() * sizeof(words[0]));
+}
+
+struct ContentHashes
+{
+    std::vector<uint64_t> hashes;
+    std::vector<int32_t> status; // 0 ok, 1 unreadable or failed to parse, 2 no notes
+    // index of the first file with the same hash, itself if none, -1 if failed or empty
+    std::vector<int64_t> groups;
+};
+
+inline ContentHashes content_hashes(std::vector<std::string> const& paths,
+    DedupOptions const& opt = {}, int threads = 0)
+{
+    ContentHashes out;
+    out.hashes.resize(paths.size());
+    out.status.resize(paths.size());
+    parallel_for(paths.size(), threads, [&] (size_t i, int) {
+        thread_local std::string data;
+        try
+        {
+            read_file(paths[i], data);
+            u8 const* raw = (u8 const*) data.data();
+            size_t n_notes = 0;
+            out.hashes[i] = content_hash(Stream { raw, raw + data.size() }, opt, &n_notes);
+            if(n_notes == 0) { out.status[i] = 2; }
+        }
+        catch(std::exception const&) { out.status[i] = 1; }
+    });
+
+    std::unordered_map<uint64_t, int64_t> first;
+    for(size_t i=0 ; i<paths.size() ; i++)
+    {
+        if(out.status[i]) { out.groups.push_back(-1); continue; }
+        out.groups.push_back(first.emplace(out.hashes[i], i).first->second);
+    }
+    return out;
+}
+
+} // namespace tensormidi
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+namespace tensormidi {
+
+// murmur3 finalizer, a cheap full-avalanche 64 bit mix
+inline uint64_t mix64(uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdull;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ull;
+    x ^= x >> 33;
+    return x;
+}
+
+// Fast non-cryptographic content hash, 8 bytes per step.
+// Good for bucketing and dedup, not for adversarial input.
+inline uint64_t hash_bytes(void const* data, size_t size, uint64_t seed=0)
+{
+    uint8_t const* p = (uint8_t const*) data;
+    uint64_t h = mix64(seed ^ (size * 0x9e3779b97f4a7c15ull));
+    for( ; size >= 8 ; p += 8, size -= 8)
+    {
+        uint64_t x;
+        std::memcpy(&x, p, 8);
+        h = mix64(h ^ x) * 0x9e3779b97f4a7c15ull;
+    }
+    uint64_t tail = 0;
+    if(size) { std::memcpy(&tail, p, size); }
+    return mix64(h ^ tail);
+}
+
+} // namespace tensormidi
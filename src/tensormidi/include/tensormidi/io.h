@@ -0,0 +1,165 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <chrono>
+#include <filesystem>
+#endif
+
+#include "tensormidi.h"
+
+namespace tensormidi {
+
+// read a whole file into data, reusing its capacity
+inline void read_file(std::string const& path, std::string & data)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    file || err("can't open file");
+    data.resize(file.tellg());
+    file.seekg(0).read(&data[0], data.size());
+    file || err("can't read file");
+}
+
+inline std::string read_file(std::string const& path)
+{
+    std::string data;
+    read_file(path, data);
+    return data;
+}
+
+// size and modification time, enough to tell a file changed
+struct FileStamp
+{
+    uint64_t size = 0;
+    int64_t mtime_ns = 0; // unix time, except on windows
+
+    FileStamp(std::string const& path)
+    {
+#ifndef _WIN32
+        struct stat st;
+        ::stat(path.c_str(), &st) == 0 || err("can't stat file");
+        size = st.st_size;
+#ifdef __APPLE__
+        mtime_ns = st.st_mtimespec.tv_sec * 1000000000ll + st.st_mtimespec.tv_nsec;
+#else
+        mtime_ns = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+#endif
+#else
+        namespace fs = std::filesystem;
+        std::error_code ec;
+        size = fs::file_size(path, ec);
+        !ec || err("can't stat file");
+        auto t = fs::last_write_time(path, ec);
+        !ec || err("can't stat file");
+        mtime_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            t.time_since_epoch()).count();
+#endif
+    }
+};
+
+// Whole file memory map. Pages are copy-on-write, so callers may scribble on
+// them without touching the file. Falls back to reading into memory on windows.
+struct MappedFile
+{
+    u8 * data = nullptr;
+    size_t size = 0;
+
+    MappedFile() {}
+
+    MappedFile(std::string const& path)
+    {
+#ifndef _WIN32
+        int fd = ::open(path.c_str(), O_RDONLY);
+        fd >= 0 || err("can't open file");
+        struct stat st;
+        if(::fstat(fd, &st) == 0) { size = st.st_size; }
+        void * p = size ? ::mmap(nullptr, size, PROT_READ | PROT_WRITE, 
+            MAP_PRIVATE, fd, 0) : nullptr;
+        ::close(fd);
+        p != MAP_FAILED || err("can't map file");
+        data = (u8 *) p;
+#else
+        std::string buf = read_file(path);
+        size = buf.size();
+        data = new u8[size];
+        std::memcpy(data, buf.data(), size);
+#endif
+    }
+
+    MappedFile(MappedFile && o) : data(o.data), size(o.size)
+    {
+        o.data = nullptr;
+        o.size = 0;
+    }
+
+    MappedFile & operator=(MappedFile && o)
+    {
+        std::swap(data, o.data);
+        std::swap(size, o.size);
+        return *this;
+    }
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile & operator=(MappedFile const&) = delete;
+
+    ~MappedFile()
+    {
+#ifndef _WIN32
+        if(data) { ::munmap(data, size); }
+#else
+        delete[] data;
+#endif
+    }
+};
+
+// Reads at explicit offsets, pread where available, for touching a few
+// bytes of many files without reading them whole.
+struct FileReader
+{
+    size_t size = 0;
+#ifndef _WIN32
+    int fd = -1;
+
+    FileReader(std::string const& path)
+    {
+        fd = ::open(path.c_str(), O_RDONLY);
+        fd >= 0 || err("can't open file");
+        struct stat st;
+        if(::fstat(fd, &st) == 0) { size = st.st_size; }
+    }
+
+    ~FileReader() { ::close(fd); }
+
+    void read(size_t offset, void * out, size_t n)
+    {
+        ::pread(fd, out, n, offset) == ssize_t(n) || err("can't read file");
+    }
+#else
+    std::ifstream file;
+
+    FileReader(std::string const& path)
+    :   file(path, std::ios::binary | std::ios::ate)
+    {
+        file || err("can't open file");
+        size = file.tellg();
+    }
+
+    void read(size_t offset, void * out, size_t n)
+    {
+        file.seekg(offset).read((char *) out, n);
+        file || err("can't read file");
+    }
+#endif
+
+    FileReader(FileReader const&) = delete;
+    FileReader & operator=(FileReader const&) = delete;
+};
+
+} // namespace tensormidi
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+
+namespace tensormidi {
+
+// Where each MTrk chunk lives in a file, found by hopping chunk lengths
+// without decoding a single event. Tracks are then decoded one at a time.
+struct Layout
+{
+    struct Chunk
+    {
+        size_t offset; // chunk body, from the start of the file
+        size_t length;
+    };
+
+    Header header;
+    std::vector<Chunk> tracks;
+
+    Layout() {}
+
+    Layout(Stream src)
+    {
+        u8 const* base = src.begin;
+        header = Header { src };
+        for(int i=0 ; i<header.n_tracks ; i++)
+        {
+            ChunkHead chunk { src, "MTrk" };
+            tracks.push_back({ size_t(chunk.data - base), chunk.length });
+        }
+    }
+
+    // tempo changes of every track, the only thing that needs a full pass
+    std::vector<Tempo> tempos(u8 const* data) const
+    {
+        std::vector<Tempo> out;
+        for(size_t i=0 ; i<tracks.size() ; i++)
+        {
+            Stream midi { data + tracks[i].offset, data + tracks[i].offset + tracks[i].length };
+            Track::State state;
+            Track::decode(midi, state, out, i, true, [] (Event const&) {});
+        }
+        sort_tempos(out);
+        return out;
+    }
+
+    // events of track i in ticks, same as File would produce for it
+    Track decode(u8 const* data, size_t i,
+        bool notes_only=true, int default_program=0) const
+    {
+        i < tracks.size() || err("track index out of range");
+        Stream midi { data + tracks[i].offset, data + tracks[i].offset + tracks[i].length };
+        Track::State state { default_program };
+        std::vector<Tempo> tempos;
+        Track out;
+        Track::decode(midi, state, tempos, i, notes_only,
+            [&] (Event const& e) { out.events.push_back(e); });
+        return out;
+    }
+};
+
+} // namespace tensormidi
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace tensormidi {
+
+// Thread safe LRU map to shared values, bounded by the total cost of entries.
+// Evicted values live on while anyone still holds them.
+template<class Key, class Value>
+struct LruCache
+{
+    struct Stats
+    {
+        size_t capacity = 0;
+        size_t cost = 0;
+        size_t entries = 0;
+        size_t hits = 0;
+        size_t misses = 0;
+    };
+
+    LruCache(size_t capacity = 0) { stats_.capacity = capacity; }
+
+    size_t capacity() const
+    {
+        std::lock_guard<std::mutex> hold(lock);
+        return stats_.capacity;
+    }
+
+    Stats stats() const
+    {
+        std::lock_guard<std::mutex> hold(lock);
+        return stats_;
+    }
+
+    std::shared_ptr<Value> get(Key const& key)
+    {
+        std::lock_guard<std::mutex> hold(lock);
+        auto it = index.find(key);
+        if(it == index.end())
+        {
+            stats_.misses ++;
+            return nullptr;
+        }
+        stats_.hits ++;
+        order.splice(order.begin(), order, it->second);
+        return it->second->value;
+    }
+
+    // values costing more than the whole capacity are not kept
+    void put(Key const& key, std::shared_ptr<Value> value, size_t cost)
+    {
+        std::lock_guard<std::mutex> hold(lock);
+        erase(key);
+        if(cost > stats_.capacity) { return; }
+        order.push_front({ key, std::move(value), cost });
+        index[key] = order.begin();
+        stats_.cost += cost;
+        stats_.entries ++;
+        shrink();
+    }
+
+    void set_capacity(size_t capacity)
+    {
+        std::lock_guard<std::mutex> hold(lock);
+        stats_.capacity = capacity;
+        shrink();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> hold(lock);
+        order.clear();
+        index.clear();
+        stats_ = Stats { stats_.capacity };
+    }
+
+private:
+    struct Entry
+    {
+        Key key;
+        std::shared_ptr<Value> value;
+        size_t cost;
+    };
+
+    mutable std::mutex lock;
+    std::list<Entry> order; // most recent first
+    std::unordered_map<Key, typename std::list<Entry>::iterator> index;
+    Stats stats_;
+
+    void erase(Key const& key)
+    {
+        auto it = index.find(key);
+        if(it == index.end()) { return; }
+        stats_.cost -= it->second->cost;
+        stats_.entries --;
+        order.erase(it->second);
+        index.erase(it);
+    }
+
+    void shrink()
+    {
+        while(stats_.cost > stats_.capacity) { erase(order.back().key); }
+    }
+};
+
+} // namespace tensormidi
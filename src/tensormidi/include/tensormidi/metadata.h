@@ -0,0 +1,106 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+#include "tensormidi/io.h"
+#include "tensormidi/parallel.h"
+
+namespace tensormidi {
+
+// Per-file stats for filtering a corpus without reparsing it.
+// Fixed layout, so a batch is one flat table of rows.
+struct Metadata
+{
+    enum { DRUMS = 9 }; // gm percussion channel, not counted in programs
+
+    double duration = 0; // seconds to the last note event
+    uint64_t programs[2] = {}; // bit p set if program p plays notes
+    uint32_t notes = 0; // note ons
+    uint16_t channels = 0; // bit c set if channel c plays notes
+    uint16_t n_tracks = 0;
+    float min_bpm = 0;
+    float max_bpm = 0;
+    uint16_t ticks_per_beat = 0;
+    u8 type = 0;
+    u8 n_time_signatures = 0; // saturates at 255
+    u8 numerator = 4; // first time signature, 4/4 if none
+    u8 denominator = 4;
+    int16_t status = 0; // 0 ok, 1 unreadable or failed to parse
+};
+
+static_assert(sizeof(Metadata) == 48, "Metadata is a fixed 48 byte row");
+
+inline Metadata describe(Stream src, int default_program=0)
+{
+    Metadata out;
+    Header header { src };
+    (header.ticks_per_beat > 0 && header.ticks_per_beat < 0x8000)
+        || err("zero or smpte time division not supported");
+    out.type = header.type;
+    out.n_tracks = header.n_tracks;
+    out.ticks_per_beat = header.ticks_per_beat;
+
+    std::vector<Tempo> tempos;
+    std::vector<TimeSignature> signatures;
+    uint64_t last = 0;
+    for(int i=0 ; i<header.n_tracks ; i++)
+    {
+        ChunkHead chunk { src, "MTrk" };
+        Stream midi { chunk.data, chunk.data + chunk.length };
+        Track::State state { default_program };
+        Track::decode(midi, state, tempos, i, true, [&] (Event const& e) {
+            last = std::max<uint64_t>(last, e.time);
+            if(e.type != Event::NOTE_ON) { return; }
+            out.notes ++;
+            out.channels |= 1 << e.channel;
+            if(e.channel != Metadata::DRUMS)
+                out.programs[e.program >> 6] |= uint64_t(1) << (e.program & 63);
+        }, &signatures);
+    }
+    sort_tempos(tempos);
+
+    Event end {};
+    end.time = last;
+    ticks_to_seconds(&end, &end+1, header.ticks_per_beat, tempos);
+    out.duration = end.time;
+
+    out.min_bpm = out.max_bpm = 120;
+    for(size_t i=0 ; i<tempos.size() ; i++)
+    {
+        float bpm = 60 / tempos[i].sec_per_beat;
+        out.min_bpm = i ? std::min(out.min_bpm, bpm) : bpm;
+        out.max_bpm = i ? std::max(out.max_bpm, bpm) : bpm;
+    }
+
+    std::sort(signatures.begin(), signatures.end(),
+        [] (auto& a, auto& b) { return a.tick < b.tick; });
+    out.n_time_signatures = std::min<size_t>(signatures.size(), 255);
+    if(signatures.size())
+    {
+        out.numerator = signatures[0].numerator;
+        out.denominator = signatures[0].denominator;
+    }
+    return out;
+}
+
+// One row per path, a bad file only sets its status
+inline std::vector<Metadata> describe_batch(std::vector<std::string> const& paths,
+    int default_program=0, int threads=0)
+{
+    std::vector<Metadata> out(paths.size());
+    parallel_for(paths.size(), threads, [&] (size_t i, int) {
+        thread_local std::string data;
+        try
+        {
+            read_file(paths[i], data);
+            u8 const* raw = (u8 const*) data.data();
+            out[i] = describe(Stream { raw, raw + data.size() }, default_program);
+        }
+        catch(std::exception const&) { out[i] = Metadata{}; out[i].status = 1; }
+    });
+    return out;
+}
+
+} // namespace tensormidi
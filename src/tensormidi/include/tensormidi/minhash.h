@@ -0,0 +1,183 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+#include "tensormidi/hash.h"
+#include "tensormidi/io.h"
+#include "tensormidi/parallel.h"
+
+namespace tensormidi {
+
+struct MinHashOptions
+{
+    int ngram = 4; // intervals per shingle
+    int resolution = 12; // onset interval grid, steps per beat
+    int bands = 16; // lsh bands, signature length is bands * rows
+    int rows = 8;
+    uint64_t seed = 0;
+
+    size_t length() const { return size_t(bands) * rows; }
+};
+
+// Shingles of a file: n-grams of pitch intervals between successive onsets,
+// invariant to transposition, and n-grams of inter-onset intervals in grid
+// steps, invariant to tempo and ticks per beat.
+inline void shingles(Stream src, MinHashOptions const& opt, std::vector<uint64_t> & out)
+{
+    Options parse;
+    parse.time_unit = Options::TICKS;
+    File f = parse_file(src, parse);
+    double steps = double(opt.resolution) / std::max(1, f.ticks_per_beat);
+
+    thread_local std::vector<std::pair<double, int>> onsets;
+    onsets.clear();
+    for(Event const& e : f.tracks[0].events)
+        if(e.type == Event::NOTE_ON) { onsets.push_back({ e.time, e.key }); }
+    std::sort(onsets.begin(), onsets.end());
+
+    thread_local std::vector<int64_t> pitch, rhythm;
+    pitch.clear();
+    rhythm.clear();
+    for(size_t i=1 ; i<onsets.size() ; i++)
+    {
+        pitch.push_back(onsets[i].second - onsets[i-1].second);
+        if(onsets[i].first != onsets[i-1].first)
+            rhythm.push_back(std::llround((onsets[i].first - onsets[i-1].first) * steps));
+    }
+
+    out.clear();
+    size_t n = opt.ngram;
+    for(size_t i=0 ; i+n<=pitch.size() ; i++)
+        out.push_back(hash_bytes(&pitch[i], n * sizeof(int64_t), 1));
+    for(size_t i=0 ; i+n<=rhythm.size() ; i++)
+        out.push_back(hash_bytes(&rhythm[i], n * sizeof(int64_t), 2));
+}
+
+// K independent 32 bit hashes of the form a * x + b, written as flat loops
+// over the signature so the compiler vectorizes them (pmulld on sse4 / avx2).
+struct MinHasher
+{
+    std::vector<uint32_t> a, b;
+
+    MinHasher(size_t k, uint64_t seed = 0)
+    {
+        for(size_t i=0 ; i<k ; i++)
+        {
+            a.push_back(uint32_t(mix64(seed + 2*i + 1)) | 1);
+            b.push_back(uint32_t(mix64(seed + 2*i + 2)));
+        }
+    }
+
+    size_t size() const { return a.size(); }
+
+    void operator()(uint64_t const* shingles, size_t n, uint32_t * signature) const
+    {
+        size_t k = a.size();
+        uint32_t const* ak = a.data();
+        uint32_t const* bk = b.data();
+        std::fill(signature, signature + k, UINT32_MAX);
+        for(size_t s=0 ; s<n ; s++)
+        {
+            uint32_t x = uint32_t(mix64(shingles[s]));
+            for(size_t i=0 ; i<k ; i++)
+                signature[i] = std::min(signature[i], ak[i] * x + bk[i]);
+        }
+    }
+};
+
+struct MinHashes
+{
+    size_t length = 0; // per signature
+    std::vector<uint32_t> signatures; // row per file, all ones if no shingles
+    std::vector<int32_t> status; // 0 ok, 1 unreadable or failed to parse
+};
+
+inline MinHashes minhash_signatures(std::vector<std::string> const& paths,
+    MinHashOptions const& opt = {}, int threads = 0)
+{
+    (opt.ngram > 0 && opt.resolution > 0 && opt.length() > 0)
+        || err("bad minhash options");
+    MinHasher hasher { opt.length(), opt.seed };
+    MinHashes out;
+    out.length = opt.length();
+    out.signatures.resize(paths.size() * out.length);
+    out.status.resize(paths.size());
+    parallel_for(paths.size(), threads, [&] (size_t i, int) {
+        thread_local std::string data;
+        thread_local std::vector<uint64_t> shingle;
+        uint32_t * signature = &out.signatures[i * out.length];
+        try
+        {
+            read_file(paths[i], data);
+            u8 const* raw = (u8 const*) data.data();
+            shingles(Stream { raw, raw + data.size() }, opt, shingle);
+            hasher(shingle.data(), shingle.size(), signature);
+        }
+        catch(std::exception const&)
+        {
+            std::fill(signature, signature + out.length, UINT32_MAX);
+            out.status[i] = 1;
+        }
+    });
+    return out;
+}
+
+struct SimilarPair
+{
+    int64_t a;
+    int64_t b;
+    float similarity; // fraction of equal signature entries
+};
+
+// Files sharing any band of `rows` signature entries become candidates, then
+// pairs below threshold estimated Jaccard similarity are dropped. Bands are
+// bucketed in parallel. Empty signatures never match.
+inline std::vector<SimilarPair> lsh_pairs(uint32_t const* signatures, size_t n,
+    int bands, int rows, float threshold = 0, int threads = 0)
+{
+    size_t k = size_t(bands) * rows;
+    auto empty = [&] (size_t i) {
+        uint32_t const* s = signatures + i * k;
+        return std::all_of(s, s + k, [] (uint32_t x) { return x == UINT32_MAX; });
+    };
+
+    std::vector<std::vector<std::pair<int64_t, int64_t>>> found(bands);
+    parallel_for(bands, threads, [&] (size_t band, int) {
+        std::unordered_map<uint64_t, std::vector<int64_t>> buckets;
+        for(size_t i=0 ; i<n ; i++)
+        {
+            if(empty(i)) { continue; }
+            uint32_t const* s = signatures + i * k + band * rows;
+            buckets[hash_bytes(s, rows * sizeof(uint32_t), band)].push_back(i);
+        }
+        for(auto const& [key, members] : buckets)
+            for(size_t x=0 ; x<members.size() ; x++)
+                for(size_t y=x+1 ; y<members.size() ; y++)
+                    found[band].push_back({ members[x], members[y] });
+    });
+
+    std::vector<std::pair<int64_t, int64_t>> candidates;
+    for(auto const& f : found) { candidates.insert(candidates.end(), f.begin(), f.end()); }
+    std::sort(candidates.begin(), candidates.end());
+    candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+    std::vector<float> similarity(candidates.size());
+    parallel_for(candidates.size(), threads, [&] (size_t c, int) {
+        uint32_t const* sa = signatures + candidates[c].first * k;
+        uint32_t const* sb = signatures + candidates[c].second * k;
+        size_t same = 0;
+        for(size_t i=0 ; i<k ; i++) { same += sa[i] == sb[i]; }
+        similarity[c] = float(same) / k;
+    });
+
+    std::vector<SimilarPair> out;
+    for(size_t c=0 ; c<candidates.size() ; c++)
+        if(similarity[c] >= threshold)
+            out.push_back({ candidates[c].first, candidates[c].second, similarity[c] });
+    return out;
+}
+
+} // namespace tensormidi
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+
+namespace tensormidi {
+
+// A sounding note, from a note on to its matching note off
+struct Note
+{
+    double start;
+    double end;
+    u8 track;
+    u8 program;
+    u8 channel;
+    u8 key;
+    u8 velocity;
+};
+
+// Pair note ons with note offs in a time sorted run of events. Overlapping
+// notes on the same channel and key close first in, first out. Notes still
+// sounding at the end close at the last event time. Output is in onset order.
+// With sustain, notes released while the channel's pedal (control 64) is
+// down sound on until it lifts, or until their key is struck again.
+inline void pair_notes(Event const* begin, Event const* end, std::vector<Note> & out,
+    bool sustain=false)
+{
+    enum { SUSTAIN = 64 };
+    out.clear();
+    // open note indexes per channel and key, oldest first
+    std::vector<std::vector<size_t>> open(16 * 128);
+    std::vector<size_t> head(16 * 128, 0);
+    // released notes held by the pedal, per channel
+    std::vector<size_t> held[16];
+    bool down[16] = {};
+    double last = begin != end ? (end-1)->time : 0;
+    auto release = [&] (int chan, double time, int key) {
+        auto & h = held[chan];
+        auto keep = std::remove_if(h.begin(), h.end(), [&] (size_t i) {
+            if(key >= 0 && out[i].key != key) { return false; }
+            out[i].end = time;
+            return true;
+        });
+        h.erase(keep, h.end());
+    };
+    for(Event const* e = begin ; e != end ; e++)
+    {
+        if(sustain && e->type == Event::CONTROL && e->key == SUSTAIN)
+        {
+            bool now = e->value >= 64;
+            if(down[e->channel] && !now) { release(e->channel, e->time, -1); }
+            down[e->channel] = now;
+            continue;
+        }
+        if(e->type != Event::NOTE_ON && e->type != Event::NOTE_OFF) { continue; }
+        size_t slot = e->channel * 128 + e->key;
+        if(e->type == Event::NOTE_ON)
+        {
+            if(sustain) { release(e->channel, e->time, e->key); }
+            open[slot].push_back(out.size());
+            out.push_back({ e->time, last, e->track, e->program,
+                e->channel, e->key, e->value });
+        }
+        else if(head[slot] < open[slot].size())
+        {
+            size_t i = open[slot][head[slot]++];
+            if(sustain && down[e->channel]) { held[e->channel].push_back(i); }
+            else { out[i].end = e->time; }
+        }
+    }
+}
+
+} // namespace tensormidi
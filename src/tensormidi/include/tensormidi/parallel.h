@@ -0,0 +1,51 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace tensormidi {
+
+// number of workers parallel_for will use, 0 means one per core
+inline int thread_count(int threads, size_t n)
+{
+    if(threads <= 0) { threads = std::thread::hardware_concurrency(); }
+    return std::max<int>(1, std::min<size_t>(threads, n));
+}
+
+// Call fn(i, worker) for every i in [0, n), spread over thread_count() workers.
+// Items are handed out one at a time, so uneven file sizes balance out.
+// The first exception thrown by fn stops the loop and is rethrown here.
+template<class Fn>
+void parallel_for(size_t n, int threads, Fn && fn)
+{
+    int workers = thread_count(threads, n);
+    std::atomic<size_t> next {0};
+    std::exception_ptr error;
+    std::mutex error_lock;
+
+    auto work = [&] (int worker) {
+        for(size_t i ; (i = next++) < n ; )
+        {
+            try { fn(i, worker); }
+            catch(...)
+            {
+                std::lock_guard<std::mutex> lock(error_lock);
+                if(!error) { error = std::current_exception(); }
+                next = n;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for(int w=1 ; w<workers ; w++) { pool.emplace_back(work, w); }
+    work(0);
+    for(std::thread & t : pool) { t.join(); }
+
+    if(error) { std::rethrow_exception(error); }
+}
+
+} // namespace tensormidi
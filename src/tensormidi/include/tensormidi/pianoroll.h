@@ -0,0 +1,228 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+#include "tensormidi/io.h"
+#include "tensormidi/notes.h"
+#include "tensormidi/parallel.h"
+
+namespace tensormidi {
+
+struct RollOptions
+{
+    enum Group { NONE, TRACKS, PROGRAMS };
+
+    double fps = 100; // frames per second
+    bool velocity = false; // cells hold velocity rather than 1
+    bool onsets = false; // extra channel marking the first frame of notes
+    bool offsets = false; // extra channel marking the frame notes end at
+    bool sustain = true; // hold notes under the sustain pedal
+    bool packed = false; // 128 keys as 16 bytes, in numpy.packbits order
+    Group group = NONE; // one roll per track, or per program with drums last
+    int64_t frames = 0; // fixed length, 0 to end at the last note
+    int default_program = 0;
+
+    int channels() const { return 1 + onsets + offsets; }
+    size_t row_bytes() const { return packed ? 16 : 128; }
+
+    void check() const
+    {
+        fps > 0 || err("fps must be positive");
+        frames >= 0 || err("frames must not be negative");
+        !(packed && velocity) || err("packed rolls can't hold velocity");
+    }
+};
+
+// Dense u8 roll laid out as [groups, channels, frames, row_bytes].
+// Channels are the sounding frames, then onsets and offsets if asked for.
+struct Roll
+{
+    int64_t frames = 0;
+    int channels = 1;
+    size_t row_bytes = 128;
+    std::vector<int32_t> groups; // track index or program (128 for drums), per group
+    std::vector<u8> data;
+    int32_t status = 0; // 0 ok, 1 unreadable or failed to parse
+
+    u8 * row(size_t group, int channel, int64_t frame)
+    {
+        return &data[((group * channels + channel) * frames + frame) * row_bytes];
+    }
+};
+
+// Groups and length of a roll of notes timed in seconds. Notes take the
+// frames their rounded start and end cover, at least one.
+struct RollLayout
+{
+    enum { DRUMS = 9 };
+
+    RollOptions const& opt;
+    std::vector<int32_t> groups; // sorted
+    int32_t slot[256]; // group index by track or program
+    int64_t frames = 0;
+
+    RollLayout(Note const* begin, Note const* end, RollOptions const& opt)
+    :   opt(opt)
+    {
+        opt.check();
+        if(opt.group == RollOptions::NONE) { groups.push_back(0); }
+        for(Note const* n = begin ; n != end ; n++)
+        {
+            if(opt.group != RollOptions::NONE) { groups.push_back(group(*n)); }
+            frames = std::max<int64_t>(frames, span(*n).second + 1);
+        }
+        std::sort(groups.begin(), groups.end());
+        groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+        for(size_t g=0 ; g<groups.size() ; g++) { slot[groups[g]] = g; }
+        if(opt.frames) { frames = opt.frames; }
+    }
+
+    int32_t group(Note const& n) const
+    {
+        if(opt.group == RollOptions::TRACKS) { return n.track; }
+        if(opt.group == RollOptions::PROGRAMS) { return n.channel == DRUMS ? 128 : n.program; }
+        return 0;
+    }
+
+    std::pair<int64_t, int64_t> span(Note const& n) const
+    {
+        int64_t on = std::llround(n.start * opt.fps);
+        return { on, std::max<int64_t>(on + 1, std::llround(n.end * opt.fps)) };
+    }
+
+    // fn(group index, channel, frame, key, value) for each cell a note sets
+    template<class Fn>
+    void each_cell(Note const* begin, Note const* end, Fn && fn) const
+    {
+        auto mark = [&] (size_t g, int channel, int64_t frame, Note const& n) {
+            if(frame >= 0 && frame < frames)
+                fn(g, channel, frame, n.key, opt.velocity ? n.velocity : 1);
+        };
+        for(Note const* n = begin ; n != end ; n++)
+        {
+            size_t g = slot[group(*n)];
+            auto [on, off] = span(*n);
+            for(int64_t f = std::max<int64_t>(on, 0) ; f < std::min(off, frames) ; f++)
+                mark(g, 0, f, *n);
+            if(opt.onsets) { mark(g, 1, on, *n); }
+            if(opt.offsets) { mark(g, 1 + opt.onsets, off, *n); }
+        }
+    }
+};
+
+// Render notes timed in seconds. Where notes overlap the loudest wins.
+inline void render_roll(Note const* begin, Note const* end, RollOptions const& opt, Roll & out)
+{
+    RollLayout layout { begin, end, opt };
+    out.groups = layout.groups;
+    out.frames = layout.frames;
+    out.channels = opt.channels();
+    out.row_bytes = opt.row_bytes();
+    out.data.assign(out.groups.size() * out.channels * out.frames * out.row_bytes, 0);
+    layout.each_cell(begin, end, [&] (size_t g, int c, int64_t f, u8 key, u8 value) {
+        u8 * row = out.row(g, c, f);
+        if(opt.packed) { row[key >> 3] |= 0x80 >> (key & 7); }
+        else { row[key] = std::max(row[key], value); }
+    });
+}
+
+// Nonzero cells of a roll as coordinates and values, sorted by group,
+// channel, frame and key with no repeats, as torch wants coalesced indices
+struct SparseRoll
+{
+    int64_t frames = 0;
+    int channels = 1;
+    std::vector<int32_t> groups; // as in Roll
+    std::vector<int64_t> indices; // [4, nnz] group, channel, frame, key rows
+    std::vector<u8> values;
+    int32_t status = 0; // 0 ok, 1 unreadable or failed to parse
+};
+
+inline void render_roll(Note const* begin, Note const* end, RollOptions const& opt, SparseRoll & out)
+{
+    !opt.packed || err("sparse rolls can't be packed");
+    RollLayout layout { begin, end, opt };
+    out.groups = layout.groups;
+    out.frames = layout.frames;
+    out.channels = opt.channels();
+
+    // cells by flat index into the dense layout, which sorts in the right order
+    thread_local std::vector<std::pair<uint64_t, u8>> cells;
+    cells.clear();
+    layout.each_cell(begin, end, [&] (size_t g, int c, int64_t f, u8 key, u8 value) {
+        cells.push_back({ ((g * out.channels + c) * out.frames + f) * 128 + key, value });
+    });
+    std::sort(cells.begin(), cells.end());
+
+    out.values.clear();
+    thread_local std::vector<uint64_t> flat;
+    flat.clear();
+    for(auto [i, v] : cells)
+    {
+        // sorted by value too, so the last of a run is the loudest
+        if(flat.size() && flat.back() == i) { out.values.back() = v; continue; }
+        flat.push_back(i);
+        out.values.push_back(v);
+    }
+    size_t nnz = flat.size();
+    out.indices.resize(4 * nnz);
+    for(size_t k=0 ; k<nnz ; k++)
+    {
+        uint64_t i = flat[k];
+        out.indices[3 * nnz + k] = i % 128;
+        i /= 128;
+        out.indices[2 * nnz + k] = i % out.frames;
+        i /= out.frames;
+        out.indices[1 * nnz + k] = i % out.channels;
+        out.indices[k] = i / out.channels;
+    }
+}
+
+// Render merged events in seconds, which need their control events for
+// sustain, to a Roll or SparseRoll
+template<class Out>
+void pianoroll(Event const* begin, Event const* end, RollOptions const& opt, Out & out)
+{
+    thread_local std::vector<Note> notes;
+    pair_notes(begin, end, notes, opt.sustain);
+    render_roll(notes.data(), notes.data() + notes.size(), opt, out);
+}
+
+template<class Out>
+void pianoroll(Stream src, RollOptions const& opt, Out & out)
+{
+    Options parse;
+    parse.notes_only = !opt.sustain;
+    parse.default_program = opt.default_program;
+    File f = parse_file(src, parse);
+    std::vector<Event> const& events = f.tracks[0].events;
+    pianoroll(events.data(), events.data() + events.size(), opt, out);
+}
+
+// A roll per file, rendered in parallel. Failed files get an empty roll.
+template<class Out = Roll>
+std::vector<Out> pianoroll_batch(std::vector<std::string> const& paths,
+    RollOptions const& opt, int threads = 0)
+{
+    opt.check();
+    std::vector<Out> out(paths.size());
+    parallel_for(paths.size(), threads, [&] (size_t i, int) {
+        thread_local std::string data;
+        try
+        {
+            read_file(paths[i], data);
+            u8 const* raw = (u8 const*) data.data();
+            pianoroll(Stream { raw, raw + data.size() }, opt, out[i]);
+        }
+        catch(std::exception const&)
+        {
+            render_roll(nullptr, nullptr, opt, out[i]);
+            out[i].status = 1;
+        }
+    });
+    return out;
+}
+
+} // namespace tensormidi
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+#include "tensormidi/io.h"
+#include "tensormidi/parallel.h"
+
+namespace tensormidi {
+
+// What a file holds, from its chunk headers alone
+struct Probe
+{
+    int type = 0;
+    int n_tracks = 0;
+    int ticks_per_beat = 0;
+    uint64_t file_size = 0;
+    std::vector<uint32_t> track_lengths;
+    uint64_t events = 0; // estimate, when asked for
+    int32_t status = 0; // 0 ok, 1 unreadable or not midi
+};
+
+// Kept events and bytes decoded from the start of a chunk body, stopping at
+// the last whole event when the body is cut short.
+inline std::pair<uint64_t, size_t> count_events(
+    u8 const* begin, u8 const* end, bool notes_only)
+{
+    Stream midi { begin, end };
+    Track::State state;
+    std::vector<Tempo> tempos;
+    uint64_t events = 0;
+    u8 const* last = begin;
+    try
+    {
+        Track::decode(midi, state, tempos, 0, notes_only, [&] (Event const&) {
+            events ++;
+            last = midi.cursor;
+        });
+        last = midi.cursor;
+    }
+    catch(std::exception const&) {}
+    return { events, size_t(last - begin) };
+}
+
+// One pread of the first `prefix` bytes, then 8 bytes per chunk header past it.
+// The event estimate is exact for tracks inside the prefix, and scales the
+// others by the event density of the first track the prefix cuts short.
+inline Probe probe(std::string const& path, bool estimate=false, size_t prefix=4096)
+{
+    Probe out;
+    FileReader file { path };
+    out.file_size = file.size;
+
+    std::vector<u8> head(std::min(prefix, file.size));
+    file.read(0, head.data(), head.size());
+    Stream src { head.data(), head.data() + head.size() };
+    Header header { src };
+    out.type = header.type;
+    out.n_tracks = header.n_tracks;
+    out.ticks_per_beat = header.ticks_per_beat;
+
+    u8 const* loaded = src.end;
+    double density = 1.0 / 3; // delta, note, velocity under running status
+    bool sampled = false;
+    uint64_t unread = 0; // bytes of tracks not fully in the prefix
+    size_t at = src.cursor - src.begin;
+    for(int i=0 ; i<header.n_tracks ; i++)
+    {
+        u8 chunk[8];
+        at + 8 <= file.size || err("truncated file");
+        if(at + 8 <= head.size()) { std::memcpy(chunk, head.data() + at, 8); }
+        else { file.read(at, chunk, 8); }
+        std::strncmp((char const*) chunk, "MTrk", 4) == 0 || err("wrong chunk type");
+        uint32_t length = big_endian<uint32_t>(chunk + 4);
+        size_t body = at + 8;
+        length <= file.size - body || err("truncated file");
+        out.track_lengths.push_back(length);
+        at = body + length;
+
+        if(!estimate) { continue; }
+        if(at <= head.size())
+        {
+            out.events += count_events(head.data() + body, head.data() + at,
+                true).first;
+            continue;
+        }
+        unread += length;
+        if(!sampled && body < head.size())
+        {
+            auto [events, bytes] = count_events(head.data() + body, loaded, true);
+            if(events >= 16) { density = double(events) / bytes; }
+            sampled = true;
+        }
+    }
+    out.events += uint64_t(unread * density);
+    return out;
+}
+
+// Probes every path, a bad file only sets its status
+inline std::vector<Probe> probe_batch(std::vector<std::string> const& paths,
+    bool estimate=false, size_t prefix=4096, int threads=0)
+{
+    std::vector<Probe> out(paths.size());
+    parallel_for(paths.size(), threads, [&] (size_t i, int) {
+        try { out[i] = probe(paths[i], estimate, prefix); }
+        catch(std::exception const&) { out[i] = Probe{}; out[i].status = 1; }
+    });
+    return out;
+}
+
+} // namespace tensormidi
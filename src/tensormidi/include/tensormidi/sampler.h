@@ -0,0 +1,253 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+#include "tensormidi/hash.h"
+#include "tensormidi/lru.h"
+#include "tensormidi/parallel.h"
+#include "tensormidi/seek.h"
+#include "tensormidi/shard.h"
+
+namespace tensormidi {
+
+// Random crops out of a shard, for training loaders that never need whole songs.
+// Parsed shards are sliced in place with a binary search on time.
+// Raw shards get a SeekIndex per file, built on first use and kept in an LRU
+// of seek_bytes, and then only the checkpoints around each window are decoded,
+// merged, and converted.
+struct Sampler
+{
+    using Rng = std::mt19937_64;
+
+    Shard const& shard;
+    Options opt;
+    size_t every;
+    std::vector<uint32_t> files; // shard entries that parsed cleanly
+    mutable LruCache<uint32_t, SeekIndex> seeks;
+
+    Sampler(Shard const& shard, Options opt = {}, size_t every = 256, 
+        size_t seek_bytes = size_t(256) << 20)
+    :   shard(shard),
+        opt(opt),
+        every(every),
+        seeks(seek_bytes)
+    {
+        this->opt.merge_tracks = true;
+        opt.time_unit != Options::GRID || opt.steps_per_beat > 0 
+            || err("steps_per_beat must be positive");
+        for(uint32_t i=0 ; i<shard.size() ; i++)
+            if(shard.index[i].status == 0) { files.push_back(i); }
+        files.size() || err("no usable files in shard");
+    }
+
+    uint32_t pick(Rng & rng) const
+    {
+        return files[std::uniform_int_distribution<size_t>(0, files.size()-1)(rng)];
+    }
+
+    // merged events of a parsed file, straight from the mapping
+    std::pair<Event const*, Event const*> cached(uint32_t file) const
+    {
+        CacheView view = shard.cache(file);
+        (view.head->merged && view.n_tracks() == 1)
+            || err("sampling needs a shard packed with merged tracks");
+        Event const* e = view.track(0);
+        return { e, e + view.track_size(0) };
+    }
+
+    // threads missing the same file at once may each build it, the last is kept
+    std::shared_ptr<SeekIndex const> seek(uint32_t file) const
+    {
+        std::shared_ptr<SeekIndex> index = seeks.get(file);
+        if(!index)
+        {
+            index = std::make_shared<SeekIndex>(shard.stream(file), 
+                opt.notes_only, opt.default_program, every);
+            seeks.put(file, index, index->bytes());
+        }
+        return index;
+    }
+
+    // tick times to opt.time_unit, in place on a sorted run
+    void convert(SeekIndex const& index, Event * begin, Event * end) const
+    {
+        double tpb = index.ticks_per_beat;
+        if(opt.time_unit == Options::SECONDS) ticks_to_seconds(begin, end, tpb, index.tempos);
+        if(opt.time_unit == Options::BEATS) ticks_to_beats(begin, end, tpb);
+        if(opt.time_unit == Options::GRID) ticks_to_grid(begin, end, tpb, opt.steps_per_beat);
+    }
+
+    double tick_time(SeekIndex const& index, uint64_t tick) const
+    {
+        Event e {};
+        e.time = tick;
+        convert(index, &e, &e+1);
+        return e.time;
+    }
+
+    // earliest tick that can land at time t, grid steps round from half a step before
+    double first_tick(SeekIndex const& index, double t) const
+    {
+        if(opt.time_unit == Options::GRID) 
+            return (t - 0.5) * index.ticks_per_beat / opt.steps_per_beat;
+        return time_tick(index, t);
+    }
+
+    // latest tick that can land at time t, grid steps round from half a step after
+    double last_tick(SeekIndex const& index, double t) const
+    {
+        if(opt.time_unit == Options::GRID) 
+            return (t + 0.5) * index.ticks_per_beat / opt.steps_per_beat;
+        return time_tick(index, t);
+    }
+
+    // tick at time t, for the units that map back exactly
+    double time_tick(SeekIndex const& index, double t) const
+    {
+        double tpb = index.ticks_per_beat;
+        if(opt.time_unit == Options::SECONDS) return seconds_to_ticks(t, tpb, index.tempos);
+        if(opt.time_unit == Options::BEATS) return t * tpb;
+        return t;
+    }
+
+    // tick-sorted events of all tracks with from <= tick < to,
+    // each track stopping after `limit` of them
+    void gather(SeekIndex const& index, u8 const* data, uint64_t from, uint64_t to,
+        size_t limit, std::vector<Event> & out) const
+    {
+        out.clear();
+        for(int t=0 ; t<int(index.tracks.size()) ; t++)
+        {
+            size_t kept = 0;
+            index.resume(data, t, index.at_tick(t, from), [&] (Event const& e) {
+                if(e.time >= to) { return false; }
+                if(e.time >= from) { out.push_back(e); kept++; }
+                return kept < limit;
+            });
+        }
+        std::sort(out.begin(), out.end(), 
+            [] (auto& a, auto& b) { return a.time < b.time; });
+    }
+
+    // n consecutive events from a random offset, fewer if the file is shorter
+    size_t crop_events(uint32_t file, size_t n, Rng & rng, Event * out) const
+    {
+        if(shard.parsed())
+        {
+            auto [begin, end] = cached(file);
+            size_t size = end - begin;
+            size_t start = size > n ?
+                std::uniform_int_distribution<size_t>(0, size - n)(rng) : 0;
+            size_t count = std::min(n, size);
+            std::copy(begin + start, begin + start + count, out);
+            return count;
+        }
+        std::shared_ptr<SeekIndex const> held = seek(file);
+        SeekIndex const& index = *held;
+        size_t size = index.n_events;
+        size_t start = size > n ?
+            std::uniform_int_distribution<size_t>(0, size - n)(rng) : 0;
+        size_t count = std::min(n, size);
+        if(count == 0) { return 0; }
+
+        // resume every track at the merged mark before start, then skip ahead
+        thread_local std::vector<Event> events;
+        SeekIndex::Mark mark = index.merged[start / every];
+        size_t skip = start - mark.before;
+        gather(index, shard.data(file), mark.tick, UINT64_MAX, skip + count, events);
+        std::copy(events.begin() + skip, events.begin() + skip + count, out);
+        convert(index, out, out + count);
+        return count;
+    }
+
+    // events in [t, t+length) from a random t, in the time unit of the shard
+    void crop_time(uint32_t file, double length, Rng & rng, std::vector<Event> & out) const
+    {
+        out.clear();
+        auto start = [&] (double first, double last) {
+            last = std::max(first, last - length);
+            return first + (last - first) * std::generate_canonical<double, 53>(rng);
+        };
+        auto before = [] (Event const& e, double t) { return e.time < t; };
+
+        if(shard.parsed())
+        {
+            auto [begin, end] = cached(file);
+            if(begin == end) { return; }
+            double t = start(begin->time, (end-1)->time);
+            Event const* lo = std::lower_bound(begin, end, t, before);
+            Event const* hi = std::lower_bound(lo, end, t + length, before);
+            out.assign(lo, hi);
+            return;
+        }
+        std::shared_ptr<SeekIndex const> held = seek(file);
+        SeekIndex const& index = *held;
+        if(index.n_events == 0) { return; }
+        double t = start(tick_time(index, index.merged[0].tick), 
+            tick_time(index, index.last_tick));
+
+        // decode a tick range with a little slack, then trim in the target unit
+        double from = std::floor(first_tick(index, t)) - 1;
+        double to = std::ceil(last_tick(index, t + length)) + 1;
+        gather(index, shard.data(file), uint64_t(std::max(0.0, from)), 
+            uint64_t(std::max(0.0, to)), SIZE_MAX, out);
+        convert(index, out.data(), out.data() + out.size());
+        auto lo = std::lower_bound(out.begin(), out.end(), t, before);
+        auto hi = std::lower_bound(lo, out.end(), t + length, before);
+        out.erase(hi, out.end());
+        out.erase(out.begin(), lo);
+    }
+};
+
+// Fills out[batch][n] with event windows from random files.
+// Window i only depends on seed and i, never on the thread count.
+inline void sample_events(
+    Sampler const& sampler,
+    size_t n,
+    size_t batch,
+    uint64_t seed,
+    Event * out,
+    uint32_t * files,
+    uint32_t * counts,
+    int threads = 0 )
+{
+    parallel_for(batch, threads, [&] (size_t i, int) {
+        Sampler::Rng rng { mix64(seed + i) };
+        files[i] = sampler.pick(rng);
+        counts[i] = sampler.crop_events(files[i], n, rng, out + i * n);
+        std::fill(out + i * n + counts[i], out + (i+1) * n, Event{});
+    });
+}
+
+// Ragged time windows, window i is events[offsets[i]:offsets[i+1]]
+inline void sample_time(
+    Sampler const& sampler,
+    double length,
+    size_t batch,
+    uint64_t seed,
+    std::vector<Event> & events,
+    std::vector<int64_t> & offsets,
+    uint32_t * files,
+    int threads = 0 )
+{
+    std::vector<std::vector<Event>> windows(batch);
+    parallel_for(batch, threads, [&] (size_t i, int) {
+        Sampler::Rng rng { mix64(seed + i) };
+        files[i] = sampler.pick(rng);
+        sampler.crop_time(files[i], length, rng, windows[i]);
+    });
+    events.clear();
+    offsets.assign(1, 0);
+    for(std::vector<Event> const& w : windows)
+    {
+        events.insert(events.end(), w.begin(), w.end());
+        offsets.push_back(events.size());
+    }
+}
+
+} // namespace tensormidi
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+#include "tensormidi/notes.h"
+
+namespace tensormidi {
+
+// Notes of a whole file in ticks, with its tempo and time signature maps
+struct Score
+{
+    int ticks_per_beat = 0;
+    std::vector<Note> notes; // onset order
+    std::vector<Tempo> tempos; // sorted, may be empty for 120 bpm
+    std::vector<TimeSignature> signatures; // sorted, starts with one at tick 0
+
+    Score() {}
+
+    Score(Stream src, int default_program=0)
+    {
+        Header header { src };
+        ticks_per_beat = header.ticks_per_beat;
+        ticks_per_beat > 0 || err("smpte time division not supported");
+
+        thread_local std::vector<Event> events;
+        events.clear();
+        for(int i=0 ; i<header.n_tracks ; i++)
+        {
+            ChunkHead chunk { src, "MTrk" };
+            Stream midi { chunk.data, chunk.data + chunk.length };
+            Track::State state { default_program };
+            Track::decode(midi, state, tempos, i, true,
+                [&] (Event const& e) { events.push_back(e); }, &signatures);
+        }
+        sort_tempos(tempos);
+        // stable, so ons and offs at one tick keep their file order
+        std::stable_sort(events.begin(), events.end(),
+            [] (auto& a, auto& b) { return a.time < b.time; });
+        pair_notes(events.data(), events.data() + events.size(), notes);
+
+        signatures.erase(std::remove_if(signatures.begin(), signatures.end(),
+            [] (auto& s) { return s.numerator == 0 || s.denominator == 0; }),
+            signatures.end());
+        std::stable_sort(signatures.begin(), signatures.end(),
+            [] (auto& a, auto& b) { return a.tick < b.tick; });
+        if(signatures.empty() || signatures[0].tick > 0)
+            signatures.insert(signatures.begin(), { 0, 4, 4, 24, 8 });
+    }
+
+    double bpm(double tick) const
+    {
+        auto it = std::upper_bound(tempos.begin(), tempos.end(), tick,
+            [] (double t, Tempo const& x) { return t < x.tick; });
+        return it == tempos.begin() ? 120 : 60 / (it-1)->sec_per_beat;
+    }
+};
+
+// Bar lines on a grid of steps_per_beat, following the time signatures up to
+// the bar holding last. A signature change cuts the bar before it short, and
+// bars longer than max_length steps are split into several.
+struct BarGrid
+{
+    struct Bar
+    {
+        int64_t start; // in steps
+        int64_t length;
+        u8 numerator;
+        u8 denominator;
+    };
+
+    std::vector<Bar> bars;
+
+    BarGrid(Score const& score, int steps_per_beat, int64_t max_length, int64_t last)
+    {
+        auto const& sigs = score.signatures;
+        double scale = double(steps_per_beat) / score.ticks_per_beat;
+        for(size_t i=0 ; i<sigs.size() ; i++)
+        {
+            int64_t at = bars.size() ? bars.back().start + bars.back().length : 0;
+            if(at > last) { break; }
+            int64_t until = i+1 < sigs.size() ? std::llround(sigs[i+1].tick * scale) : INT64_MAX;
+            int64_t length = std::max<int64_t>(1, std::llround(
+                4.0 * steps_per_beat * sigs[i].numerator / sigs[i].denominator));
+            while(at < until && at <= last)
+            {
+                for(int64_t part = 0 ; part < length && at < until ; )
+                {
+                    int64_t n = std::min({ length - part, max_length, until - at });
+                    bars.push_back({ at, n, sigs[i].numerator, sigs[i].denominator });
+                    at += n;
+                    part += n;
+                }
+            }
+        }
+    }
+
+    // index of the bar holding step
+    size_t find(int64_t step) const
+    {
+        auto it = std::upper_bound(bars.begin(), bars.end(), step,
+            [] (int64_t s, Bar const& b) { return s < b.start; });
+        return it == bars.begin() ? 0 : it - bars.begin() - 1;
+    }
+};
+
+} // namespace tensormidi
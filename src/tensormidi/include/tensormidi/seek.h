@@ -0,0 +1,156 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+
+namespace tensormidi {
+
+// inverse of ticks_to_seconds for a single time
+inline double seconds_to_ticks(double seconds,
+    double ticks_per_beat, std::vector<Tempo> const& tempos)
+{
+    double sec_per_tick = 0.5 / ticks_per_beat;
+    double at = 0;
+    uint64_t tick = 0;
+    for(Tempo const& t : tempos)
+    {
+        double next = at + (t.tick - tick) * sec_per_tick;
+        if(next > seconds) { break; }
+        at = next;
+        tick = t.tick;
+        sec_per_tick = t.sec_per_beat / ticks_per_beat;
+    }
+    return tick + (seconds - at) / sec_per_tick;
+}
+
+// Decoder state taken right after a kept event, so decoding can resume there
+struct Checkpoint
+{
+    uint32_t offset = 0; // bytes into the chunk body
+    uint64_t events = 0; // kept events before this point
+    Track::State state;
+};
+
+// One pass over a file recording a checkpoint every `every` kept events per
+// track, plus the full tempo map, so any slice decodes without replaying the
+// track from its start. Event counts follow notes_only, as parsing would.
+struct SeekIndex
+{
+    struct TrackIndex
+    {
+        size_t begin = 0; // chunk body offset in the file
+        size_t length = 0;
+        uint64_t n_events = 0;
+        std::vector<Checkpoint> checkpoints;
+    };
+
+    int type = 0;
+    int ticks_per_beat = 0;
+    bool notes_only = true;
+    size_t every = 0;
+    std::vector<Tempo> tempos;
+    std::vector<TrackIndex> tracks;
+    // tick of every `every`-th event of the merged tracks,
+    // and how many merged events come strictly before that tick
+    struct Mark { uint64_t tick; uint64_t before; };
+    std::vector<Mark> merged;
+    uint64_t n_events = 0;
+    uint64_t last_tick = 0;
+
+    SeekIndex(Stream src, bool notes_only=true, int default_program=0, size_t every=256)
+    :   notes_only(notes_only),
+        every(every)
+    {
+        every > 0 || err("checkpoint interval must be positive");
+        u8 const* file = src.begin;
+        Header head { src };
+        type = head.type;
+        ticks_per_beat = head.ticks_per_beat;
+
+        std::vector<uint64_t> ticks;
+        for(int t=0 ; t<head.n_tracks ; t++)
+        {
+            ChunkHead chunk { src, "MTrk" };
+            TrackIndex index;
+            index.begin = chunk.data - file;
+            index.length = chunk.length;
+
+            Stream midi { chunk.data, chunk.data + chunk.length };
+            Track::State state { default_program };
+            index.checkpoints.push_back({ 0, 0, state });
+            Track::decode(midi, state, tempos, t, notes_only, [&] (Event const&) {
+                ticks.push_back(state.tick);
+                if(++index.n_events % every == 0)
+                    index.checkpoints.push_back({
+                        uint32_t(midi.cursor - midi.begin), index.n_events, state });
+            });
+            n_events += index.n_events;
+            tracks.push_back(std::move(index));
+        }
+        sort_tempos(tempos);
+
+        std::sort(ticks.begin(), ticks.end());
+        for(size_t i=0 ; i<ticks.size() ; i+=every)
+        {
+            size_t before = std::lower_bound(ticks.begin(), ticks.begin()+i, ticks[i]) - ticks.begin();
+            merged.push_back({ ticks[i], before });
+        }
+        last_tick = ticks.size() ? ticks.back() : 0;
+    }
+
+    // rough memory footprint, for caching
+    size_t bytes() const
+    {
+        size_t n = sizeof(*this) + tempos.size() * sizeof(Tempo) + merged.size() * sizeof(Mark);
+        for(TrackIndex const& t : tracks)
+            n += sizeof(TrackIndex) + t.checkpoints.size() * sizeof(Checkpoint);
+        return n;
+    }
+
+    // last checkpoint at or before kept event `event` of track t
+    Checkpoint const& at_event(int t, uint64_t event) const
+    {
+        std::vector<Checkpoint> const& c = tracks.at(t).checkpoints;
+        return c[std::min<size_t>(event / every, c.size() - 1)];
+    }
+
+    // last checkpoint that skips no event at or after tick
+    Checkpoint const& at_tick(int t, uint64_t tick) const
+    {
+        std::vector<Checkpoint> const& c = tracks.at(t).checkpoints;
+        auto it = std::partition_point(c.begin() + 1, c.end(),
+            [&] (Checkpoint const& x) { return x.state.tick < tick; });
+        return *(it - 1);
+    }
+
+    // decode track t from a checkpoint, emit as in Track::decode.
+    // data is the same file bytes the index was built from.
+    template<class Emit>
+    void resume(u8 const* data, int t, Checkpoint const& from, Emit && emit) const
+    {
+        TrackIndex const& index = tracks.at(t);
+        Stream midi { data + index.begin, data + index.begin + index.length };
+        midi.take(from.offset);
+        Track::State state = from.state;
+        std::vector<Tempo> seen; // already in tempos
+        Track::decode(midi, state, seen, t, notes_only, emit);
+    }
+
+    // kept events [first, first+count) of track t, in ticks
+    std::vector<Event> read(u8 const* data, int t, uint64_t first, uint64_t count) const
+    {
+        std::vector<Event> out;
+        if(count == 0) { return out; }
+        Checkpoint const& from = at_event(t, first);
+        uint64_t i = from.events;
+        resume(data, t, from, [&] (Event const& e) {
+            if(i++ >= first) { out.push_back(e); }
+            return out.size() < count;
+        });
+        return out;
+    }
+};
+
+} // namespace tensormidi
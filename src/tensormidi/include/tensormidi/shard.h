@@ -0,0 +1,205 @@
+#pragma once
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include "tensormidi.h"
+#include "cache.h"
+#include "hash.h"
+#include "io.h"
+#include "parallel.h"
+
+namespace tensormidi {
+
+// A shard packs many files into one, so a corpus of tiny files costs one open
+// and mmap instead of millions. Native byte order:
+//   ShardHeader | blob | blob | ... | ShardEntry[n_files]
+// Blobs are 64 byte aligned and hold raw midi bytes or .tmidi images.
+struct ShardHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t kind;
+    uint32_t _reserved;
+    uint64_t n_files;
+    uint64_t index_offset;
+
+    enum Kind { RAW = 0, PARSED = 1 };
+
+    static constexpr char const* MAGIC = "TMSH";
+    static constexpr uint32_t VERSION = 1;
+};
+
+static_assert(sizeof(ShardHeader) == 32, "ShardHeader layout");
+
+struct ShardEntry
+{
+    uint64_t offset;
+    uint64_t length;
+    uint64_t hash; // hash_bytes of the original midi file
+    uint32_t n_events; // note on / off events
+    uint16_t n_tracks;
+    uint16_t ticks_per_beat;
+    float duration; // seconds
+    int32_t status; // 0 ok, 1 failed to parse (blob is empty if parsed)
+};
+
+static_assert(sizeof(ShardEntry) == 40, "ShardEntry layout");
+
+// Fill the entry stats of one midi file and return its blob for kind
+inline std::string make_blob(std::string const& midi, ShardHeader::Kind kind,
+    Options const& opt, ShardEntry & entry)
+{
+    entry = ShardEntry {};
+    entry.hash = hash_bytes(midi.data(), midi.size());
+    try
+    {
+        u8 const* raw = (u8 const*) midi.data();
+        Stream src {raw, raw+midi.size()};
+        File f { src };
+        entry.n_tracks = f.tracks.size();
+        entry.ticks_per_beat = f.ticks_per_beat;
+        f.to_seconds();
+        for(Track const& t : f.tracks)
+        {
+            entry.n_events += t.events.size();
+            if(t.events.size())
+                entry.duration = std::max<float>(entry.duration, t.events.back().time);
+        }
+        if(kind == ShardHeader::RAW) { return midi; }
+
+        src = Stream {raw, raw+midi.size()};
+        return encode_cache(parse_file(src, opt), opt);
+    }
+    catch(std::exception const&)
+    {
+        entry.status = 1;
+        return (kind == ShardHeader::RAW) ? midi : std::string();
+    }
+}
+
+// Appends blobs in order, the index is written by finish()
+struct ShardWriter
+{
+    std::ofstream file;
+    ShardHeader head {};
+    std::vector<ShardEntry> index;
+    uint64_t offset = 0;
+
+    ShardWriter(std::string const& path, ShardHeader::Kind kind)
+    :   file(path, std::ios::binary)
+    {
+        file || err("can't open file");
+        std::memcpy(head.magic, ShardHeader::MAGIC, 4);
+        head.version = ShardHeader::VERSION;
+        head.kind = kind;
+        write(&head, sizeof(head));
+    }
+
+    ~ShardWriter()
+    {
+        if(file.is_open()) { try { finish(); } catch(...) {} }
+    }
+
+    void write(void const* data, size_t size)
+    {
+        file.write((char const*) data, size);
+        offset += size;
+    }
+
+    void pad()
+    {
+        static char const zeros[CacheHeader::ALIGN] = {};
+        write(zeros, CacheHeader::align(offset) - offset);
+    }
+
+    ShardWriter & add(std::string const& blob, ShardEntry entry)
+    {
+        pad();
+        entry.offset = offset;
+        entry.length = blob.size();
+        write(blob.data(), blob.size());
+        index.push_back(entry);
+        return *this;
+    }
+
+    void finish()
+    {
+        pad();
+        head.n_files = index.size();
+        head.index_offset = offset;
+        write(index.data(), index.size() * sizeof(ShardEntry));
+        file.seekp(0);
+        file.write((char const*) &head, sizeof(head));
+        file.close();
+        file || err("can't write shard");
+    }
+};
+
+// Pack paths into one shard, in order. Files are read and parsed in parallel,
+// a chunk at a time to bound memory. Unreadable files get status 1 as well.
+inline void pack_shard(std::vector<std::string> const& paths, 
+    std::string const& out, ShardHeader::Kind kind, Options const& opt,
+    int threads=0, size_t chunk=1024)
+{
+    ShardWriter writer { out, kind };
+    std::vector<std::string> blobs(chunk);
+    std::vector<ShardEntry> entries(chunk);
+    for(size_t begin=0 ; begin<paths.size() ; begin+=chunk)
+    {
+        size_t n = std::min(chunk, paths.size() - begin);
+        parallel_for(n, threads, [&] (size_t i, int) {
+            std::string midi;
+            try { read_file(paths[begin+i], midi); } catch(std::exception const&) {}
+            blobs[i] = make_blob(midi, kind, opt, entries[i]);
+        });
+        for(size_t i=0 ; i<n ; i++) { writer.add(blobs[i], entries[i]); }
+    }
+    writer.finish();
+}
+
+// Memory mapped shard with O(1) access to any file
+struct Shard
+{
+    MappedFile map;
+    ShardHeader const* head = nullptr;
+    ShardEntry const* index = nullptr;
+
+    Shard(std::string const& path)
+    :   map(path)
+    {
+        map.size >= sizeof(ShardHeader) || err("short shard");
+        head = (ShardHeader const*) map.data;
+        std::memcmp(head->magic, ShardHeader::MAGIC, 4) == 0 || err("not a shard");
+        head->version == ShardHeader::VERSION || err("unsupported shard version");
+        (head->index_offset <= map.size && head->n_files <= 
+            (map.size - head->index_offset) / sizeof(ShardEntry)) || err("truncated shard");
+        index = (ShardEntry const*)(map.data + head->index_offset);
+        for(size_t i=0 ; i<size() ; i++)
+            (index[i].offset <= head->index_offset && index[i].length <= 
+                head->index_offset - index[i].offset) || err("bad shard index");
+    }
+
+    size_t size() const { return head->n_files; }
+    bool parsed() const { return head->kind == ShardHeader::PARSED; }
+
+    ShardEntry const& entry(size_t i) const
+    {
+        i < size() || err("shard index out of range");
+        return index[i];
+    }
+    u8 * data(size_t i) const { return map.data + entry(i).offset; }
+    size_t length(size_t i) const { return entry(i).length; }
+
+    Stream stream(size_t i) const { return { data(i), data(i) + length(i) }; }
+
+    CacheView cache(size_t i) const
+    {
+        parsed() || err("shard holds raw midi");
+        entry(i).status == 0 || err("file failed to parse when packed");
+        return { data(i), length(i) };
+    }
+};
+
+} // namespace tensormidi
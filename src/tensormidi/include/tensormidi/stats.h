@@ -0,0 +1,142 @@
+#pragma once
+
+#include <functional>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+#include "tensormidi/io.h"
+#include "tensormidi/notes.h"
+#include "tensormidi/parallel.h"
+
+namespace tensormidi {
+
+// Fixed width bins from lo, out of range values land in the end bins
+struct Histogram
+{
+    double lo = 0;
+    double width = 1;
+    std::vector<uint64_t> counts;
+
+    Histogram() {}
+    Histogram(double lo, double hi, double width)
+    :   lo(lo),
+        width(width),
+        counts(std::max<size_t>(1, std::ceil((hi - lo) / width)))
+    {
+    }
+
+    void add(double x)
+    {
+        double bin = std::floor((x - lo) / width);
+        counts[size_t(std::clamp<double>(bin, 0, counts.size() - 1))] ++;
+    }
+
+    Histogram & operator+=(Histogram const& o)
+    {
+        for(size_t i=0 ; i<counts.size() ; i++) { counts[i] += o.counts[i]; }
+        return *this;
+    }
+};
+
+// Note level distributions of a corpus, in seconds and beats per minute
+struct CorpusStats
+{
+    enum { DRUMS = 9 };
+
+    Histogram pitch { 0, 128, 1 }; // note ons
+    Histogram velocity { 0, 128, 1 };
+    Histogram program { 0, 129, 1 }; // 128 for drums
+    Histogram channel { 0, 16, 1 };
+    Histogram duration { 0, 8, 0.02 }; // note on to off
+    Histogram ioi { 0, 4, 0.01 }; // between successive distinct onsets
+    Histogram polyphony { 0, 64, 1 }; // notes sounding at each onset
+    Histogram tempo { 0, 300, 2 }; // every tempo change
+    Histogram length { 0, 1200, 5 }; // seconds to the last note event
+    uint64_t files = 0;
+    uint64_t failed = 0;
+
+    template<class Fn>
+    void each(Fn && fn)
+    {
+        fn("pitch", pitch);
+        fn("velocity", velocity);
+        fn("program", program);
+        fn("channel", channel);
+        fn("duration", duration);
+        fn("ioi", ioi);
+        fn("polyphony", polyphony);
+        fn("tempo", tempo);
+        fn("length", length);
+    }
+
+    CorpusStats & operator+=(CorpusStats const& o)
+    {
+        pitch += o.pitch;
+        velocity += o.velocity;
+        program += o.program;
+        channel += o.channel;
+        duration += o.duration;
+        ioi += o.ioi;
+        polyphony += o.polyphony;
+        tempo += o.tempo;
+        length += o.length;
+        files += o.files;
+        failed += o.failed;
+        return *this;
+    }
+
+    void add(File & f)
+    {
+        for(Tempo const& t : f.tempos) { tempo.add(60 / t.sec_per_beat); }
+        f.merge_tracks();
+        f.to_seconds();
+        std::vector<Event> const& events = f.tracks[0].events;
+
+        thread_local std::vector<Note> notes;
+        pair_notes(events.data(), events.data() + events.size(), notes);
+
+        std::priority_queue<double, std::vector<double>, std::greater<double>> sounding;
+        for(size_t i=0 ; i<notes.size() ; i++)
+        {
+            Note const& n = notes[i];
+            pitch.add(n.key);
+            velocity.add(n.velocity);
+            program.add(n.channel == DRUMS ? 128 : n.program);
+            channel.add(n.channel);
+            duration.add(n.end - n.start);
+            if(i && n.start > notes[i-1].start) { ioi.add(n.start - notes[i-1].start); }
+            while(sounding.size() && sounding.top() <= n.start) { sounding.pop(); }
+            sounding.push(n.end);
+            polyphony.add(sounding.size());
+        }
+        length.add(events.size() ? events.back().time : 0);
+        files ++;
+    }
+};
+
+// Streams every file through per-worker stats, then sums them.
+// No events outlive the file they came from.
+inline CorpusStats corpus_stats(std::vector<std::string> const& paths, 
+    int default_program = 0, int threads = 0)
+{
+    std::vector<CorpusStats> partial(thread_count(threads, paths.size()));
+    parallel_for(paths.size(), threads, [&] (size_t i, int worker) {
+        thread_local std::string data;
+        try
+        {
+            read_file(paths[i], data);
+            u8 const* raw = (u8 const*) data.data();
+            Stream src { raw, raw + data.size() };
+            File f { src, true, default_program };
+            partial[worker].add(f);
+        }
+        catch(std::exception const&) { partial[worker].failed ++; }
+    });
+    CorpusStats out;
+    for(CorpusStats const& p : partial) { out += p; }
+    return out;
+}
+
+} // namespace tensormidi
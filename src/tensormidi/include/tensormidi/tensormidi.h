@@ -4,12 +4,14 @@
 #include <vector>
 #include <cstring>
 #include <algorithm>
+#include <cmath>
+#include <type_traits>
 
 namespace tensormidi {
 
 using u8 = uint8_t;
 
-bool err(char const* msg) { throw std::runtime_error(msg); }
+inline bool err(char const* msg) { throw std::runtime_error(msg); }
 
 struct Stream
 {
@@ -23,7 +25,11 @@ struct Stream
         (cursor += n) <= end || err("EOF");
         return out;
     }
-    u8 peek() const { return *cursor; }
+    u8 peek() const
+    {
+        cursor < end || err("EOF");
+        return *cursor;
+    }
     size_t remain() const { return end - cursor; }
 };
 
@@ -76,6 +82,15 @@ struct Tempo
     double sec_per_beat;
 };
 
+struct TimeSignature
+{
+    uint64_t tick;
+    u8 numerator;
+    u8 denominator; // as written in the score, not the power of 2 stored in the file
+    u8 clocks_per_click;
+    u8 notated_32nds; // per quarter note
+};
+
 struct Event
 {
     double time;
@@ -104,6 +119,65 @@ struct Event
     };
 };
 
+inline void sort_tempos(std::vector<Tempo> & tempos)
+{
+    for(size_t i=1 ; i<tempos.size() ; i++)
+        if(tempos[i-1].tick > tempos[i].tick)
+        {
+            std::sort(tempos.begin(), tempos.end(), 
+                [] (auto& a, auto& b) { return a.tick < b.tick; });
+            break;
+        }
+}
+
+// Time conversions operate in place on a tick-sorted run of events
+
+inline void ticks_to_seconds(Event * begin, Event * end, 
+    double ticks_per_beat, std::vector<Tempo> const& tempos,
+    double * beats=nullptr)
+{
+    auto tempo = tempos.begin();
+    double sec_per_tick = 0.5 / ticks_per_beat;
+    double seconds = 0;
+    uint64_t tick = 0;
+    auto step_to = [&] (uint64_t t) {
+        seconds += (t-tick) * sec_per_tick;
+        tick = t;
+    };
+    for(Event * e = begin ; e != end ; e++)
+    {
+        while(tempo != tempos.end() && tempo->tick <= e->time)
+        {
+            step_to(tempo->tick);
+            sec_per_tick = tempo->sec_per_beat / ticks_per_beat;
+            tempo ++;
+        }
+        step_to(e->time);
+        if(beats) { *beats++ = e->time / ticks_per_beat; }
+        e->time = seconds;
+    }
+}
+
+inline void ticks_to_beats(Event * begin, Event * end, double ticks_per_beat)
+{
+    for(Event * e = begin ; e != end ; e++)
+        e->time /= ticks_per_beat;
+}
+
+// snap tick times to a grid of steps_per_beat, time becomes the step index
+// residual is the signed distance to that step, in steps [-0.5, 0.5]
+inline void ticks_to_grid(Event * begin, Event * end, 
+    double ticks_per_beat, int steps_per_beat, float * residual=nullptr)
+{
+    for(Event * e = begin ; e != end ; e++)
+    {
+        double pos = e->time * steps_per_beat / ticks_per_beat;
+        double step = std::round(pos);
+        if(residual) { *residual++ = pos - step; }
+        e->time = step;
+    }
+}
+
 struct Track
 {
     struct Meta
@@ -113,32 +187,71 @@ struct Track
             MSG = 0xFF,
             END_OF_TRACK = 0x2F,
             SET_TEMPO = 0x51,
+            TIME_SIGNATURE = 0x58,
         };
     };
 
     std::vector<Event> events;
+    // optional beat position per event, filled by to_seconds(..., true)
+    std::vector<double> beats;
+    // optional sub-step offset per event, filled by quantize(..., true)
+    std::vector<float> residual;
 
     Track() {}
 
     Track(Stream & src, std::vector<Tempo> & tempos, 
         int track, bool notes_only=true, int default_program=0)
     {
-        ChunkHead head { src, "MTrk" };
-        Stream midi { head.data, head.data + head.length };
+        parse(src, tempos, track, notes_only, default_program,
+            [&] (Event const& e) { events.push_back(e); });
+    }
 
+    // decoder state between two events, enough to resume mid-chunk
+    struct State
+    {
+        uint64_t tick = 0;
         u8 status = 0;
         u8 program[16];
-        for(int i=0 ; i<16 ; i++) { program[i] = default_program; }
-        uint64_t time = 0;
+
+        State(int default_program=0)
+        {
+            for(int i=0 ; i<16 ; i++) { program[i] = default_program; }
+        }
+    };
+
+    // decode one MTrk chunk, handing each kept event to emit(Event const&)
+    template<class Emit>
+    static void parse(Stream & src, std::vector<Tempo> & tempos, 
+        int track, bool notes_only, int default_program, Emit && emit)
+    {
+        ChunkHead head { src, "MTrk" };
+        Stream midi { head.data, head.data + head.length };
+        State state { default_program };
+        decode(midi, state, tempos, track, notes_only, emit);
+    }
+
+    // decode the rest of a chunk body from state. emit may return false to stop,
+    // which leaves midi and state at the next event, ready to resume.
+    // Time signatures are skipped unless signatures is given.
+    template<class Emit>
+    static void decode(Stream & midi, State & state, std::vector<Tempo> & tempos, 
+        int track, bool notes_only, Emit && emit,
+        std::vector<TimeSignature> * signatures = nullptr)
+    {
+        u8 & status = state.status;
+        u8 * program = state.program;
+        uint64_t & time = state.tick;
+        bool more = true;
 
         auto add_event = [&] (u8 type, u8 chan, u8 key, u8 val) {
-            events.push_back({ time, u8(track), program[chan],
-                chan, type, key, val });
+            Event e { double(time), u8(track), program[chan], chan, type, key, val };
+            if constexpr (std::is_same_v<decltype(emit(e)), bool>) { more = emit(e); }
+            else { emit(e); }
         };
         auto clip = [&] (u8 x) { return std::min<u8>(x, 127); };
         auto check = [&] (u8 x) { return x<128 ? x : err("data byte > 127"); };
 
-        while(midi.remain())
+        while(more && midi.remain())
         {
             time += variable_int<uint64_t>(midi);
 
@@ -151,16 +264,24 @@ struct Track
                 {
                     u8 mtype = *midi.take(1);
                     if( mtype == Meta::END_OF_TRACK )
+                    {
+                        midi.cursor = midi.end;
                         break;
+                    }
                     uint32_t mlen = variable_int<uint32_t>(midi);
                     u8 const* d = midi.take(mlen);
-                    if( mtype == Meta::SET_TEMPO )
+                    if( mtype == Meta::SET_TEMPO && mlen >= 3 )
                     {
                         if(tempos.size()==0 && time>0)
                             tempos.push_back({0, 0.5});
                         double usec_per_beat = (d[0]<<16)|(d[1]<<8)|d[2];
                         tempos.push_back({time, usec_per_beat / 1e6});
                     }
+                    if( mtype == Meta::TIME_SIGNATURE && mlen >= 4 && signatures )
+                    {
+                        signatures->push_back({time, d[0], 
+                            u8(d[1] < 8 ? 1 << d[1] : 0), d[2], d[3]});
+                    }
                 }
                 continue;
             }
@@ -202,7 +323,7 @@ struct Track
             {
                 u8 const* m = midi.take(1);
                 if(!notes_only)
-                    add_event(type, chan, 0, clip(m[1]));
+                    add_event(type, chan, 0, clip(m[0]));
             }
             else if( type == Event::PROGRAM )
             {
@@ -213,31 +334,51 @@ struct Track
         }
     }
 
-    Track & to_seconds(double ticks_per_beat, std::vector<Tempo> const& tempos)
+    Track & to_seconds(double ticks_per_beat, std::vector<Tempo> const& tempos,
+        bool keep_beats=false)
     {
-        auto tempo = tempos.begin();
-        double sec_per_tick = 0.5 / ticks_per_beat;
-        double seconds = 0;
-        uint64_t tick = 0;
-        auto step_to = [&] (uint64_t t) {
-            seconds += (t-tick) * sec_per_tick;
-            tick = t;
-        };
-        for(Event & e : events)
-        {
-            while(tempo != tempos.end() && tempo->tick <= e.time)
-            {
-                step_to(tempo->tick);
-                sec_per_tick = tempo->sec_per_beat / ticks_per_beat;
-                tempo ++;
-            }
-            step_to(e.time);
-            e.time = seconds;
-        }
+        if(keep_beats) { beats.resize(events.size()); }
+        ticks_to_seconds(events.data(), events.data() + events.size(),
+            ticks_per_beat, tempos, keep_beats ? beats.data() : nullptr);
+        return *this;
+    }
+
+    Track & to_beats(double ticks_per_beat)
+    {
+        ticks_to_beats(events.data(), events.data() + events.size(),
+            ticks_per_beat);
+        return *this;
+    }
+
+    Track & quantize(double ticks_per_beat, int steps_per_beat, 
+        bool keep_residual=false)
+    {
+        if(keep_residual) { residual.resize(events.size()); }
+        ticks_to_grid(events.data(), events.data() + events.size(),
+            ticks_per_beat, steps_per_beat, 
+            keep_residual ? residual.data() : nullptr);
         return *this;
     }
 };
 
+struct Header
+{
+    int type = 0;
+    int n_tracks = 0;
+    int ticks_per_beat = 0;
+
+    Header() {}
+
+    Header(Stream & src)
+    {
+        ChunkHead head { src, "MThd" };
+        head.length >= 6 || err("short MThd");
+        type = big_endian<uint16_t>(head.data+0);
+        n_tracks = big_endian<uint16_t>(head.data+2);
+        ticks_per_beat = big_endian<uint16_t>(head.data+4);
+    }
+};
+
 struct File
 {
     int type = 0;
@@ -245,34 +386,45 @@ struct File
     std::vector<Tempo> tempos;
     std::vector<Track> tracks;
 
+    File() {}
+
     File(Stream & src, bool notes_only=true, int default_program=0)
     {
-        ChunkHead head { src, "MThd" };
-        type = big_endian<uint16_t>(head.data+0);
-        int n_tracks = big_endian<uint16_t>(head.data+2);
-        ticks_per_beat = big_endian<uint16_t>(head.data+4);
+        Header head { src };
+        type = head.type;
+        ticks_per_beat = head.ticks_per_beat;
 
-        for(int i=0 ; i<n_tracks ; i++)
-            tracks.emplace_back(src, tempos, i, notes_only);
+        for(int i=0 ; i<head.n_tracks ; i++)
+            tracks.emplace_back(src, tempos, i, notes_only, default_program);
 
-        for(size_t i=1 ; i<tempos.size() ; i++)
-            if(tempos[i-1].tick > tempos[i].tick)
-            {
-                std::sort(tempos.begin(), tempos.end(), 
-                    [] (auto& a, auto& b) { return a.tick < b.tick; });
-                break;
-            }
+        sort_tempos(tempos);
     }
 
-    File & to_seconds()
+    File & to_seconds(bool keep_beats=false)
     {
         for(Track & t : tracks)
-            t.to_seconds(ticks_per_beat, tempos);
+            t.to_seconds(ticks_per_beat, tempos, keep_beats);
         tempos.clear();
         ticks_per_beat = 0;
         return *this;
     }
 
+    // tempo-invariant quarter-note time, tempos stay valid in ticks
+    File & to_beats()
+    {
+        for(Track & t : tracks)
+            t.to_beats(ticks_per_beat);
+        return *this;
+    }
+
+    File & quantize(int steps_per_beat, bool keep_residual=false)
+    {
+        steps_per_beat > 0 || err("steps_per_beat must be positive");
+        for(Track & t : tracks)
+            t.quantize(ticks_per_beat, steps_per_beat, keep_residual);
+        return *this;
+    }
+
     File & merge_tracks()
     {
         Track out;
@@ -291,4 +443,100 @@ struct File
     }
 };
 
+struct Options
+{
+    enum TimeUnit { TICKS, SECONDS, BEATS, GRID };
+
+    bool merge_tracks = true;
+    bool notes_only = true;
+    int default_program = 0;
+    TimeUnit time_unit = SECONDS;
+    int steps_per_beat = 0; // for GRID
+};
+
+// parse a whole file and merge / convert it as opt asks
+inline File parse_file(Stream & src, Options const& opt)
+{
+    File f { src, opt.notes_only, opt.default_program };
+    if(opt.merge_tracks) f.merge_tracks();
+    if(opt.time_unit == Options::SECONDS) f.to_seconds();
+    if(opt.time_unit == Options::BEATS) f.to_beats();
+    if(opt.time_unit == Options::GRID) f.quantize(opt.steps_per_beat);
+    return f;
+}
+
+// Parse a whole file straight into caller memory, with no per-file allocation
+// once tempos has grown. Tracks are laid out back to back, or merged into one
+// time sorted run. Returns the number of events in the file. When that exceeds
+// capacity, out holds the first capacity of them (earliest, if merged).
+inline size_t parse_into(Stream & src, Options const& opt,
+    Event * out, size_t capacity,
+    std::vector<Tempo> & tempos, int * ticks_per_beat=nullptr)
+{
+    Stream start = src;
+    Header head { src };
+    if(ticks_per_beat) { *ticks_per_beat = head.ticks_per_beat; }
+    opt.time_unit != Options::GRID || opt.steps_per_beat > 0 
+        || err("steps_per_beat must be positive");
+
+    tempos.clear();
+    size_t n = 0;
+    for(int i=0 ; i<head.n_tracks ; i++)
+    {
+        Track::parse(src, tempos, i, opt.notes_only, opt.default_program,
+            [&] (Event const& e) { if(n < capacity) { out[n] = e; } n++; });
+    }
+    sort_tempos(tempos);
+
+    if(n > capacity && opt.merge_tracks)
+    {
+        // the earliest events may be anywhere, take the slow path
+        File f { start, opt.notes_only, opt.default_program };
+        f.merge_tracks();
+        std::copy_n(f.tracks[0].events.begin(), capacity, out);
+    }
+    else if(opt.merge_tracks)
+    {
+        std::sort(out, out + n, 
+            [] (auto& a, auto& b) { return a.time < b.time; });
+    }
+
+    auto convert = [&] (Event * begin, Event * end) {
+        double tpb = head.ticks_per_beat;
+        if(opt.time_unit == Options::SECONDS)
+            ticks_to_seconds(begin, end, tpb, tempos);
+        else if(opt.time_unit == Options::BEATS)
+            ticks_to_beats(begin, end, tpb);
+        else if(opt.time_unit == Options::GRID)
+            ticks_to_grid(begin, end, tpb, opt.steps_per_beat);
+    };
+    Event * end = out + std::min(n, capacity);
+    if(opt.merge_tracks) { convert(out, end); }
+    for(Event * run = out ; !opt.merge_tracks && run != end ; )
+    {
+        Event * next = run;
+        while(next != end && next->track == run->track) { next ++; }
+        convert(run, next);
+        run = next;
+    }
+    return n;
+}
+
+// Exception free parse_into for C callers, reusing a per-thread tempo list.
+// Returns the number of events in the file, or -1 if it fails to parse.
+inline int64_t parse_buffer(u8 const* data, size_t size, Options const& opt,
+    Event * out, size_t capacity, int * ticks_per_beat=nullptr) noexcept
+{
+    thread_local std::vector<Tempo> tempos;
+    try
+    {
+        Stream src {data, data+size};
+        return parse_into(src, opt, out, capacity, tempos, ticks_per_beat);
+    }
+    catch(...)
+    {
+        return -1;
+    }
+}
+
 } // namespace tensormidi
\ No newline at end of file
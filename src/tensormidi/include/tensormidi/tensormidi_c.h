@@ -0,0 +1,106 @@
+#pragma once
+
+/* Stable C API over the tensormidi parser, built as libtensormidi.
+ * Struct layouts match the C++ Event / Tempo and the numpy dtypes. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TENSORMIDI_C_API_VERSION 1
+
+#if defined(_WIN32) && defined(tensormidi_c_EXPORTS)
+#define TENSORMIDI_API __declspec(dllexport)
+#elif defined(_WIN32) && !defined(TENSORMIDI_C_STATIC)
+#define TENSORMIDI_API __declspec(dllimport)
+#elif defined(__GNUC__)
+#define TENSORMIDI_API __attribute__((visibility("default")))
+#else
+#define TENSORMIDI_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct tensormidi_event
+{
+    double time;
+    uint8_t track;
+    uint8_t program;
+    uint8_t channel;
+    uint8_t type;
+    uint8_t key;
+    uint8_t value;
+    uint8_t _reserved[2];
+} tensormidi_event;
+
+typedef struct tensormidi_tempo
+{
+    uint64_t tick;
+    double sec_per_beat;
+} tensormidi_tempo;
+
+enum tensormidi_time_unit
+{
+    TENSORMIDI_TICKS = 0,
+    TENSORMIDI_SECONDS = 1,
+    TENSORMIDI_BEATS = 2,
+    TENSORMIDI_GRID = 3,
+};
+
+typedef struct tensormidi_options
+{
+    int32_t merge_tracks;    /* merge all tracks into 1 */
+    int32_t time_unit;       /* tensormidi_time_unit */
+    int32_t notes_only;      /* keep only NOTE_ON and NOTE_OFF events */
+    int32_t default_program; /* fallback when track doesn't specify program */
+    int32_t steps_per_beat;  /* grid size for TENSORMIDI_GRID */
+} tensormidi_options;
+
+/* a parsed file, owns its event and tempo arrays */
+typedef struct tensormidi_file tensormidi_file;
+
+TENSORMIDI_API int32_t tensormidi_version(void);
+
+/* merged, seconds, notes only, program 0 */
+TENSORMIDI_API tensormidi_options tensormidi_default_options(void);
+
+/* parse a file, NULL on failure (see tensormidi_last_error)
+ * opt may be NULL for defaults, data is not referenced after return */
+TENSORMIDI_API tensormidi_file * tensormidi_open_buffer(
+    uint8_t const* data, size_t size, tensormidi_options const* opt);
+TENSORMIDI_API tensormidi_file * tensormidi_open_path(
+    char const* path, tensormidi_options const* opt);
+TENSORMIDI_API void tensormidi_free(tensormidi_file * file);
+
+/* message for the last failure on this thread */
+TENSORMIDI_API char const* tensormidi_last_error(void);
+
+TENSORMIDI_API int32_t tensormidi_format(tensormidi_file const* file);
+/* 0 once times are in seconds */
+TENSORMIDI_API int32_t tensormidi_ticks_per_beat(tensormidi_file const* file);
+TENSORMIDI_API size_t tensormidi_track_count(tensormidi_file const* file);
+/* arrays stay valid until tensormidi_free */
+TENSORMIDI_API tensormidi_event const* tensormidi_track_events(
+    tensormidi_file const* file, size_t track, size_t * count);
+/* empty once times are in seconds */
+TENSORMIDI_API tensormidi_tempo const* tensormidi_tempos(
+    tensormidi_file const* file, size_t * count);
+
+/* Parse straight into a caller buffer with no allocation. Returns the number 
+ * of events in the file, which exceeds capacity when only the first capacity 
+ * were written, or -1 on failure, see tensormidi_last_error. ticks_per_beat 
+ * may be NULL. */
+TENSORMIDI_API int64_t tensormidi_parse_into(
+    void const* data, int64_t size,
+    void * out, int64_t capacity,
+    int32_t merge_tracks, 
+    int32_t time_unit, 
+    int32_t notes_only,
+    int32_t default_program,
+    int32_t steps_per_beat,
+    int32_t * ticks_per_beat);
+
+#ifdef __cplusplus
+} /* extern "C" */
+#endif
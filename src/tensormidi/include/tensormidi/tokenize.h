@@ -0,0 +1,624 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+#include "tensormidi/io.h"
+#include "tensormidi/parallel.h"
+#include "tensormidi/score.h"
+#include "tensormidi/write.h"
+
+namespace tensormidi {
+
+// Token rows of many files back to back. Row r of file i is in
+// [offsets[i], offsets[i+1]), each row width values wide.
+template<class T>
+struct Ragged
+{
+    size_t width = 1;
+    std::vector<T> values;
+    std::vector<int64_t> offsets; // rows, one more than files
+    std::vector<int32_t> status; // 0 ok, 1 unreadable or failed to parse
+};
+
+// Run tokenize(Stream, std::vector<T> &) over files in parallel and pack the
+// results. Failed files get no tokens.
+template<class T, class Tokenize>
+Ragged<T> tokenize_batch(std::vector<std::string> const& paths,
+    size_t width, int threads, Tokenize && tokenize)
+{
+    std::vector<std::vector<T>> parts(paths.size());
+    Ragged<T> out;
+    out.width = width;
+    out.status.resize(paths.size());
+    parallel_for(paths.size(), threads, [&] (size_t i, int) {
+        thread_local std::string data;
+        try
+        {
+            read_file(paths[i], data);
+            u8 const* raw = (u8 const*) data.data();
+            tokenize(Stream { raw, raw + data.size() }, parts[i]);
+        }
+        catch(std::exception const&)
+        {
+            parts[i].clear();
+            out.status[i] = 1;
+        }
+    });
+
+    size_t total = 0;
+    for(auto const& p : parts) { total += p.size(); }
+    out.values.reserve(total);
+    out.offsets.push_back(0);
+    for(auto & p : parts)
+    {
+        out.values.insert(out.values.end(), p.begin(), p.end());
+        out.offsets.push_back(out.values.size() / width);
+        std::vector<T>().swap(p);
+    }
+    return out;
+}
+
+// Velocity bins of equal width, decoded to their middle
+inline int velocity_bin(int velocity, int bins) { return velocity * bins / 128; }
+
+inline u8 bin_velocity(int bin, int bins)
+{
+    return bins ? std::clamp((2 * bin + 1) * 64 / bins, 1, 127) : 64;
+}
+
+// Decode the token rows of many files to midi file bytes in parallel.
+// Tokenizer::decode(T const*, size_t rows, Sequence &) rebuilds each file.
+template<class T, class Tokenizer>
+std::vector<std::string> detokenize_batch(Tokenizer const& tok, T const* tokens,
+    int64_t const* offsets, size_t n_files, size_t width, int threads = 0)
+{
+    std::vector<std::string> out(n_files);
+    parallel_for(n_files, threads, [&] (size_t i, int) {
+        (offsets[i] >= 0 && offsets[i] <= offsets[i+1]) || err("offsets must be ascending");
+        thread_local Sequence seq;
+        tok.decode(tokens + offsets[i] * width, offsets[i+1] - offsets[i], seq);
+        write_midi(seq, out[i]);
+    });
+    return out;
+}
+
+// Performance RNN style tokens: note on, note off and time shift, with
+// velocity and program tokens put before the notes they change for.
+// Events are merged and timed in seconds.
+struct MidiLike
+{
+    int steps_per_second = 100; // time shift resolution
+    int max_shift = 100; // steps per time shift token, longer gaps chain them
+    int velocity_bins = 32; // 0 for no velocity tokens
+    bool programs = false; // 129 program tokens, the last for drums
+    int default_program = 0; // before any program change, when parsing files
+
+    enum { NOTE_ON = 0, NOTE_OFF = 128, TIME_SHIFT = 256, DRUMS = 9 };
+    int velocity() const { return TIME_SHIFT + max_shift; }
+    int program() const { return velocity() + velocity_bins; }
+    int vocab_size() const { return program() + (programs ? 129 : 0); }
+
+    void check() const
+    {
+        (steps_per_second > 0 && max_shift > 0)
+            || err("time shift steps must be positive");
+        (velocity_bins >= 0 && velocity_bins <= 128)
+            || err("velocity_bins must be in [0, 128]");
+    }
+
+    // program token offset of an event, drums share one
+    static int instrument(Event const& e)
+    {
+        return e.channel == DRUMS ? 128 : e.program;
+    }
+
+    void operator()(Event const* begin, Event const* end, std::vector<int32_t> & out) const
+    {
+        check();
+        out.clear();
+        // sounding notes per channel and key
+        thread_local std::vector<int> open;
+        open.assign(16 * 128, 0);
+        thread_local std::vector<Event> group;
+        thread_local std::vector<bool> done;
+        int64_t step = 0;
+        int64_t at = 0;
+        int inst = -1;
+        int vel = -1;
+
+        // shift up to the current step only once it has a token, so steps
+        // with nothing to say (stray offs) don't split a gap in pieces
+        auto advance = [&] () {
+            for(int64_t shift = at - step ; shift > 0 ; shift -= max_shift)
+                out.push_back(TIME_SHIFT + std::min<int64_t>(shift, max_shift) - 1);
+            step = std::max(step, at);
+        };
+        auto set_instrument = [&] (Event const& e) {
+            advance();
+            if(!programs || instrument(e) == inst) { return; }
+            inst = instrument(e);
+            out.push_back(program() + inst);
+        };
+        auto note_off = [&] (Event const& e) {
+            set_instrument(e);
+            out.push_back(NOTE_OFF + e.key);
+            open[e.channel * 128 + e.key] --;
+        };
+        auto note_on = [&] (Event const& e) {
+            set_instrument(e);
+            int bin = velocity_bin(e.value, velocity_bins);
+            if(velocity_bins && bin != vel)
+            {
+                vel = bin;
+                out.push_back(velocity() + bin);
+            }
+            out.push_back(NOTE_ON + e.key);
+            open[e.channel * 128 + e.key] ++;
+        };
+
+        for(Event const* run = begin ; run != end ; )
+        {
+            at = std::llround(run->time * steps_per_second);
+            Event const* next = run;
+            while(next != end && std::llround(next->time * steps_per_second) == at) { next ++; }
+
+            // by program then key, so simultaneous notes always read the same
+            group.assign(run, next);
+            std::stable_sort(group.begin(), group.end(), [&] (auto& a, auto& b) {
+                int ia = programs ? instrument(a) : 0, ib = programs ? instrument(b) : 0;
+                return ia < ib || (ia == ib && a.key < b.key);
+            });
+            // offs of notes from earlier steps, then ons, then the rest of
+            // the offs, so a note restruck in one step is not cut short
+            done.assign(group.size(), false);
+            for(size_t i=0 ; i<group.size() ; i++)
+                if(group[i].type == Event::NOTE_OFF && open[group[i].channel * 128 + group[i].key] > 0)
+                {
+                    note_off(group[i]);
+                    done[i] = true;
+                }
+            for(Event const& e : group)
+                if(e.type == Event::NOTE_ON) { note_on(e); }
+            for(size_t i=0 ; i<group.size() ; i++)
+                if(group[i].type == Event::NOTE_OFF && !done[i]
+                    && open[group[i].channel * 128 + group[i].key] > 0) { note_off(group[i]); }
+            run = next;
+        }
+    }
+
+    // parse and tokenize a whole file
+    void operator()(Stream src, std::vector<int32_t> & out) const
+    {
+        Options parse;
+        parse.default_program = default_program;
+        File f = parse_file(src, parse);
+        std::vector<Event> const& events = f.tracks[0].events;
+        (*this)(events.data(), events.data() + events.size(), out);
+    }
+
+    // back to merged events in seconds, notes left open close at the end
+    void decode(int32_t const* tokens, size_t n, std::vector<Event> & out) const
+    {
+        check();
+        out.clear();
+        thread_local std::vector<int> open;
+        open.assign(16 * 128, 0);
+        ChannelMap channels;
+        double time = 0;
+        int inst = default_program;
+        u8 vel = bin_velocity(velocity_bins / 2, velocity_bins);
+
+        for(size_t i=0 ; i<n ; i++)
+        {
+            int t = tokens[i];
+            (t >= 0 && t < vocab_size()) || err("token out of range");
+            u8 chan = t < TIME_SHIFT ? channels(inst) : 0;
+            u8 prog = inst < 128 ? inst : 0;
+            if(t < NOTE_OFF)
+            {
+                out.push_back({ time, 0, prog, chan, Event::NOTE_ON, u8(t), vel });
+                open[chan * 128 + t] ++;
+            }
+            else if(t < TIME_SHIFT)
+            {
+                u8 key = t - NOTE_OFF;
+                if(open[chan * 128 + key] == 0) { continue; }
+                out.push_back({ time, 0, prog, chan, Event::NOTE_OFF, key, 0 });
+                open[chan * 128 + key] --;
+            }
+            else if(t < velocity()) { time += double(t - TIME_SHIFT + 1) / steps_per_second; }
+            else if(t < program()) { vel = bin_velocity(t - velocity(), velocity_bins); }
+            else { inst = t - program(); }
+        }
+        for(size_t i=out.size() ; i-- ; )
+        {
+            Event e = out[i];
+            if(e.type != Event::NOTE_ON) { continue; }
+            for( ; open[e.channel * 128 + e.key] > 0 ; open[e.channel * 128 + e.key] --)
+            {
+                e.time = time;
+                e.type = Event::NOTE_OFF;
+                e.value = 0;
+                out.push_back(e);
+            }
+        }
+    }
+
+    void decode(int32_t const* tokens, size_t n, Sequence & out) const
+    {
+        thread_local std::vector<Event> events;
+        decode(tokens, n, events);
+        seconds_to_sequence(events.data(), events.data() + events.size(), out);
+    }
+};
+
+// Quantization shared by the bar based tokenizers. Timing is in grid steps
+// of the tick clock, so tempo changes don't move notes.
+struct GridTokens
+{
+    int steps_per_beat = 4; // grid resolution, per quarter note
+    int max_bar = 32; // positions in steps, longer bars split
+    int max_duration = 32; // in steps, longer notes clip
+    int velocity_bins = 32; // 0 for no velocity
+    int tempo_bins = 32; // linear over [min_bpm, max_bpm], 0 for none
+    double min_bpm = 40;
+    double max_bpm = 250;
+    int default_program = 0;
+
+    enum { DRUMS = 9 };
+
+    void check() const
+    {
+        (steps_per_beat > 0 && max_bar > 0 && max_duration > 0)
+            || err("steps, bar and duration sizes must be positive");
+        (velocity_bins >= 0 && velocity_bins <= 128)
+            || err("velocity_bins must be in [0, 128]");
+        (tempo_bins >= 0 && min_bpm > 0 && max_bpm > min_bpm)
+            || err("bad tempo bins");
+    }
+
+    int tempo_bin(double bpm) const
+    {
+        double x = (bpm - min_bpm) / (max_bpm - min_bpm) * tempo_bins;
+        return std::clamp<int>(std::floor(x), 0, tempo_bins - 1);
+    }
+
+    int velocity_bin(int velocity) const { return tensormidi::velocity_bin(velocity, velocity_bins); }
+
+    static int instrument(Note const& n) { return n.channel == DRUMS ? 128 : n.program; }
+
+    // step of a tick on the grid of score
+    struct Clock
+    {
+        double scale;
+        int64_t operator()(double tick) const { return std::llround(tick * scale); }
+        double tick(int64_t step) const { return step / scale; }
+    };
+
+    Clock clock(Score const& score) const
+    {
+        return { double(steps_per_beat) / score.ticks_per_beat };
+    }
+
+    // notes by onset step, then instrument if it is encoded, then pitch
+    void sorted(Score const& score, std::vector<Note> & notes, bool by_instrument = true) const
+    {
+        Clock step = clock(score);
+        notes = score.notes;
+        std::stable_sort(notes.begin(), notes.end(), [&] (auto& a, auto& b) {
+            int64_t sa = step(a.start), sb = step(b.start);
+            if(sa != sb) { return sa < sb; }
+            if(by_instrument && instrument(a) != instrument(b)) { return instrument(a) < instrument(b); }
+            return a.key < b.key;
+        });
+    }
+
+    int64_t duration_steps(Clock step, Note const& n) const
+    {
+        return std::clamp<int64_t>(step(n.end) - step(n.start), 1, max_duration);
+    }
+
+    double bin_bpm(int bin) const
+    {
+        return min_bpm + (bin + 0.5) * (max_bpm - min_bpm) / tempo_bins;
+    }
+
+    // decoding side: rebuilt notes go to out as events in ticks
+    struct Writer
+    {
+        GridTokens const& tok;
+        Sequence & out;
+        double ticks_per_step;
+        ChannelMap channels;
+
+        Writer(GridTokens const& tok, Sequence & out)
+        :   tok(tok),
+            out(out),
+            ticks_per_step(double(out.ticks_per_beat) / tok.steps_per_beat)
+        {
+            out.events.clear();
+            out.tempos.clear();
+            out.signatures.clear();
+        }
+
+        double tick(int64_t step) const { return std::round(step * ticks_per_step); }
+
+        void note(int64_t step, int64_t duration, int instrument, int key, u8 velocity)
+        {
+            (key >= 0 && key < 128) || err("pitch out of range");
+            (instrument >= 0 && instrument <= 128) || err("program out of range");
+            u8 chan = channels(instrument);
+            u8 prog = instrument < 128 ? instrument : 0;
+            out.events.push_back({ tick(step), 0, prog, chan, Event::NOTE_ON, u8(key), velocity });
+            out.events.push_back({ tick(step + duration), 0, prog, chan, Event::NOTE_OFF, u8(key), 0 });
+        }
+
+        void tempo(int64_t step, int bin)
+        {
+            double sec_per_beat = 60 / tok.bin_bpm(bin);
+            if(out.tempos.size() && out.tempos.back().sec_per_beat == sec_per_beat) { return; }
+            // the first tempo also covers any lead in
+            out.tempos.push_back({ out.tempos.size() ? uint64_t(tick(step)) : 0, sec_per_beat });
+        }
+
+        // bar of length steps, spelled over the smallest denominator it fits
+        void signature(int64_t step, int64_t length)
+        {
+            int beats = tok.steps_per_beat;
+            int denominator = 4;
+            while(denominator < 64 && length * denominator % (4 * beats)) { denominator *= 2; }
+            int64_t numerator = std::max<int64_t>(1, std::llround(double(length) * denominator / (4 * beats)));
+            signature(step, std::min<int64_t>(numerator, 255), denominator);
+        }
+
+        void signature(int64_t step, int numerator, int denominator)
+        {
+            if(out.signatures.size() && out.signatures.back().numerator == numerator
+                && out.signatures.back().denominator == denominator) { return; }
+            out.signatures.push_back({ uint64_t(tick(step)), u8(numerator), u8(denominator), 24, 8 });
+        }
+
+        // offs sort before ons at a tick, so restruck notes survive
+        void finish()
+        {
+            std::stable_sort(out.events.begin(), out.events.end(), [] (auto& a, auto& b) {
+                return a.time < b.time || (a.time == b.time && a.type < b.type);
+            });
+        }
+    };
+};
+
+// REMI tokens: a Bar line, then per onset a Position in the bar and, for
+// each note there, Pitch, Velocity and Duration. Tempo tokens follow the
+// Position when the tempo bin changes.
+struct Remi : GridTokens
+{
+    bool programs = false; // program before each pitch, 128 for drums
+    bool bar_lengths = false; // bar length after a bar line where it changes
+
+    enum { BAR = 0, POSITION = 1 };
+    int pitch() const { return POSITION + max_bar; }
+    int velocity() const { return pitch() + 128; }
+    int duration() const { return velocity() + velocity_bins; }
+    int tempo() const { return duration() + max_duration; }
+    int program() const { return tempo() + tempo_bins; }
+    int bar_length() const { return program() + (programs ? 129 : 0); }
+    int vocab_size() const { return bar_length() + (bar_lengths ? max_bar : 0); }
+
+    void operator()(Score const& score, std::vector<int32_t> & out) const
+    {
+        check();
+        out.clear();
+        Clock step = clock(score);
+        thread_local std::vector<Note> notes;
+        sorted(score, notes, programs);
+        if(notes.empty()) { return; }
+        BarGrid grid { score, steps_per_beat, max_bar, step(notes.back().start) };
+
+        size_t bar = 0;
+        int64_t length = 0;
+        int64_t position = -1;
+        int bpm = -1;
+        auto bar_line = [&] {
+            out.push_back(BAR);
+            int64_t n = grid.bars[bar].length;
+            if(bar_lengths && n != length) { out.push_back(bar_length() + n - 1); }
+            length = n;
+        };
+        bar_line();
+        for(Note const& n : notes)
+        {
+            int64_t at = step(n.start);
+            for(size_t b = grid.find(at) ; bar < b ; )
+            {
+                bar ++;
+                position = -1;
+                bar_line();
+            }
+            if(at - grid.bars[bar].start != position)
+            {
+                position = at - grid.bars[bar].start;
+                out.push_back(POSITION + position);
+                int bin = tempo_bins ? tempo_bin(score.bpm(step.tick(at))) : bpm;
+                if(bin != bpm)
+                {
+                    bpm = bin;
+                    out.push_back(tempo() + bin);
+                }
+            }
+            if(programs) { out.push_back(program() + instrument(n)); }
+            out.push_back(pitch() + n.key);
+            if(velocity_bins) { out.push_back(velocity() + velocity_bin(n.velocity)); }
+            out.push_back(duration() + duration_steps(step, n) - 1);
+        }
+    }
+
+    void operator()(Stream src, std::vector<int32_t> & out) const
+    {
+        (*this)(Score { src, default_program }, out);
+    }
+
+    // Bars are 4/4, split as in BarGrid, unless bar length tokens say
+    // otherwise. A note needs its Pitch and Duration, tokens out of that
+    // order are skipped.
+    void decode(int32_t const* tokens, size_t n, Sequence & out) const
+    {
+        check();
+        Writer writer { *this, out };
+        int64_t length = 4 * steps_per_beat; // of the whole bar, before splitting
+        int64_t part = 0; // into the bar
+        auto piece = [&] { return std::min<int64_t>(length - part, max_bar); };
+        int64_t start = 0;
+        int64_t at = 0;
+        bool first = true;
+        int inst = default_program;
+        int key = -1;
+        u8 vel = bin_velocity(velocity_bins / 2, velocity_bins);
+
+        for(size_t i=0 ; i<n ; i++)
+        {
+            int t = tokens[i];
+            (t >= 0 && t < vocab_size()) || err("token out of range");
+            if(t == BAR)
+            {
+                if(!first)
+                {
+                    start += piece();
+                    part += max_bar;
+                    if(part >= length) { part = 0; }
+                }
+                first = false;
+                at = start;
+            }
+            else if(t < pitch()) { at = start + t - POSITION; }
+            else if(t < velocity()) { key = t - pitch(); }
+            else if(t < duration()) { vel = bin_velocity(t - velocity(), velocity_bins); }
+            else if(t < tempo())
+            {
+                if(key >= 0) { writer.note(at, t - duration() + 1, inst, key, vel); }
+                key = -1;
+            }
+            else if(t < program()) { writer.tempo(at, t - tempo()); }
+            else if(t < bar_length()) { inst = t - program(); }
+            else
+            {
+                length = t - bar_length() + 1;
+                part = 0;
+                writer.signature(start, length);
+            }
+        }
+        writer.finish();
+    }
+};
+
+// Octuple style compound tokens: one row of FIELDS values per note, in the
+// same order as Remi. Fields are plain values rather than vocabulary ids,
+// each with its own embedding in the model.
+struct Octuple : GridTokens
+{
+    enum Field
+    {
+        BAR, // index from the first bar, saturates at INT16_MAX
+        POSITION, // step in the bar
+        PITCH,
+        DURATION, // steps, 1 to max_duration
+        VELOCITY, // bin, 0 if no velocity_bins
+        PROGRAM, // 128 for drums
+        TEMPO, // bin, 0 if no tempo_bins
+        TIME_SIGNATURE, // numerator * 8 + log2(denominator)
+        FIELDS
+    };
+
+    static int16_t time_signature(int numerator, int denominator)
+    {
+        int log2 = 0;
+        while((2 << log2) <= denominator) { log2 ++; }
+        return numerator * 8 + log2;
+    }
+
+    void operator()(Score const& score, std::vector<int16_t> & out) const
+    {
+        check();
+        out.clear();
+        Clock step = clock(score);
+        thread_local std::vector<Note> notes;
+        sorted(score, notes);
+        if(notes.empty()) { return; }
+        BarGrid grid { score, steps_per_beat, max_bar, step(notes.back().start) };
+
+        out.reserve(notes.size() * FIELDS);
+        for(Note const& n : notes)
+        {
+            int64_t at = step(n.start);
+            size_t bar = grid.find(at);
+            BarGrid::Bar const& b = grid.bars[bar];
+            int16_t row[FIELDS];
+            row[BAR] = std::min<size_t>(bar, INT16_MAX);
+            row[POSITION] = at - b.start;
+            row[PITCH] = n.key;
+            row[DURATION] = duration_steps(step, n);
+            row[VELOCITY] = velocity_bins ? velocity_bin(n.velocity) : 0;
+            row[PROGRAM] = instrument(n);
+            row[TEMPO] = tempo_bins ? tempo_bin(score.bpm(step.tick(at))) : 0;
+            row[TIME_SIGNATURE] = time_signature(b.numerator, b.denominator);
+            out.insert(out.end(), row, row + FIELDS);
+        }
+    }
+
+    void operator()(Stream src, std::vector<int16_t> & out) const
+    {
+        (*this)(Score { src, default_program }, out);
+    }
+
+    // Bars are laid out from the time signature field, split as in BarGrid.
+    // Bars without notes keep the signature before them, and a change in
+    // the middle of a bar is lost.
+    void decode(int16_t const* rows, size_t n, Sequence & out) const
+    {
+        check();
+        Writer writer { *this, out };
+        int64_t bar = 0;
+        int64_t start = 0;
+        int64_t length = 0; // of the whole bar, before splitting
+        int64_t part = 0; // into the bar
+        int16_t sig = -1;
+
+        auto set_signature = [&] (int16_t s) {
+            int numerator = s >> 3;
+            int denominator = 1 << (s & 7);
+            (s > 0 && numerator > 0) || err("bad time signature");
+            sig = s;
+            length = std::max<int64_t>(1, std::llround(4.0 * steps_per_beat * numerator / denominator));
+            part = 0;
+            writer.signature(start, numerator, denominator);
+        };
+        auto piece = [&] { return std::min<int64_t>(length - part, max_bar); };
+
+        for(size_t i=0 ; i<n ; i++)
+        {
+            int16_t const* row = rows + i * FIELDS;
+            if(sig < 0) { set_signature(row[TIME_SIGNATURE]); }
+            row[BAR] >= bar || err("bars must not go back");
+            for( ; bar < row[BAR] ; bar++)
+            {
+                start += piece();
+                part += max_bar;
+                if(part >= length) { part = 0; }
+            }
+            if(row[TIME_SIGNATURE] != sig && part == 0) { set_signature(row[TIME_SIGNATURE]); }
+            (row[POSITION] >= 0 && row[POSITION] < max_bar) || err("position out of range");
+            (row[DURATION] > 0 && row[DURATION] <= max_duration) || err("duration out of range");
+            (row[VELOCITY] >= 0 && row[VELOCITY] < std::max(velocity_bins, 1))
+                || err("velocity out of range");
+            (row[TEMPO] >= 0 && row[TEMPO] < std::max(tempo_bins, 1)) || err("tempo out of range");
+            if(tempo_bins) { writer.tempo(start + row[POSITION], row[TEMPO]); }
+            writer.note(start + row[POSITION], row[DURATION], row[PROGRAM], row[PITCH],
+                bin_velocity(row[VELOCITY], velocity_bins));
+        }
+        writer.finish();
+    }
+};
+
+} // namespace tensormidi
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "tensormidi/tensormidi.h"
+
+namespace tensormidi {
+
+// One merged track in ticks, ready to write out
+struct Sequence
+{
+    int ticks_per_beat = 480;
+    std::vector<Event> events; // tick sorted
+    std::vector<Tempo> tempos; // tick sorted, empty for 120 bpm
+    std::vector<TimeSignature> signatures; // tick sorted
+};
+
+// Sequence from merged events in seconds, at a constant 120 bpm
+inline void seconds_to_sequence(Event const* begin, Event const* end, Sequence & out)
+{
+    out.tempos.clear();
+    out.signatures.clear();
+    out.events.assign(begin, end);
+    double ticks_per_second = out.ticks_per_beat / 0.5;
+    for(Event & e : out.events) { e.time = std::round(e.time * ticks_per_second); }
+}
+
+// Write a type 0 standard midi file. Program changes go in front of the
+// first event of a channel that has a new program, tempo and time
+// signature meta events in front of events at the same tick.
+inline void write_midi(Sequence const& seq, std::string & out)
+{
+    (seq.ticks_per_beat > 0 && seq.ticks_per_beat < 0x8000)
+        || err("ticks_per_beat must be in [1, 32767]");
+    auto put = [] (std::string & s, uint64_t x, int bytes) {
+        for(int i=bytes-1 ; i>=0 ; i--) { s.push_back(char(x >> (8*i))); }
+    };
+
+    thread_local std::string track;
+    track.clear();
+    uint64_t now = 0;
+    auto delta = [&] (double time) {
+        uint64_t tick = std::max<double>(0, std::round(time));
+        uint64_t d = tick > now ? tick - now : 0;
+        now = std::max(now, tick);
+        u8 bytes[10];
+        int n = 0;
+        do { bytes[n++] = d & 0x7f; d >>= 7; } while(d);
+        for(int i=n-1 ; i>=0 ; i--) { track.push_back(char(bytes[i] | (i ? 0x80 : 0))); }
+    };
+    auto meta = [&] (double time, u8 type, std::initializer_list<u8> data) {
+        delta(time);
+        track.push_back(char(Track::Meta::MSG));
+        track.push_back(char(type));
+        track.push_back(char(data.size()));
+        for(u8 d : data) { track.push_back(char(d)); }
+    };
+
+    int program[16];
+    std::fill(program, program + 16, -1);
+    auto tempo = seq.tempos.begin();
+    auto signature = seq.signatures.begin();
+    for(size_t i=0 ; i<=seq.events.size() ; i++)
+    {
+        double time = i < seq.events.size() ? seq.events[i].time : INFINITY;
+        while(true)
+        {
+            bool t = tempo != seq.tempos.end() && tempo->tick <= time;
+            bool s = signature != seq.signatures.end() && signature->tick <= time;
+            if(!t && !s) { break; }
+            if(s && (!t || signature->tick <= tempo->tick))
+            {
+                u8 log2 = 0;
+                while((2 << log2) <= signature->denominator) { log2 ++; }
+                meta(signature->tick, Track::Meta::TIME_SIGNATURE, { signature->numerator, 
+                    log2, signature->clocks_per_click, signature->notated_32nds });
+                signature ++;
+                continue;
+            }
+            uint32_t usec = std::clamp<double>(std::round(tempo->sec_per_beat * 1e6), 1, 0xFFFFFF);
+            meta(tempo->tick, Track::Meta::SET_TEMPO, { u8(usec >> 16), u8(usec >> 8), u8(usec) });
+            tempo ++;
+        }
+        if(i == seq.events.size()) { break; }
+
+        Event const& e = seq.events[i];
+        u8 chan = e.channel & 0x0F;
+        if(program[chan] != e.program)
+        {
+            program[chan] = e.program;
+            delta(e.time);
+            track.push_back(char(Event::PROGRAM | chan));
+            track.push_back(char(e.program & 0x7f));
+        }
+        if( e.type == Event::NOTE_OFF || e.type == Event::NOTE_ON ||
+            e.type == Event::POLY_AFTERTOUCH || e.type == Event::CONTROL ||
+            e.type == Event::PITCH_BEND )
+        {
+            delta(e.time);
+            track.push_back(char(e.type | chan));
+            track.push_back(char(e.key & 0x7f));
+            track.push_back(char(e.value & 0x7f));
+        }
+        else if( e.type == Event::CHAN_AFTERTOUCH )
+        {
+            delta(e.time);
+            track.push_back(char(e.type | chan));
+            track.push_back(char(e.value & 0x7f));
+        }
+    }
+    meta(now, Track::Meta::END_OF_TRACK, {});
+
+    out.clear();
+    out += "MThd";
+    put(out, 6, 4);
+    put(out, 0, 2); // type
+    put(out, 1, 2); // tracks
+    put(out, seq.ticks_per_beat, 2);
+    out += "MTrk";
+    put(out, track.size(), 4);
+    out += track;
+}
+
+// Gives each instrument (a program, or 128 for drums) a channel of its own,
+// in order of first use and skipping the drum channel, wrapping after 15.
+struct ChannelMap
+{
+    enum { DRUMS = 9 };
+    int channel[129];
+    int next = 0;
+
+    ChannelMap() { std::fill(channel, channel + 129, -1); }
+
+    u8 operator()(int instrument)
+    {
+        if(instrument == 128) { return DRUMS; }
+        if(channel[instrument] < 0)
+        {
+            channel[instrument] = next;
+            next = (next + 1) % 16;
+            if(next == DRUMS) { next ++; }
+        }
+        return channel[instrument];
+    }
+};
+
+} // namespace tensormidi
@@ -1,51 +1,163 @@
+#include <optional>
+
 #include <nanobind/nanobind.h>
 #include <nanobind/stl/vector.h>
 #include <nanobind/stl/string.h>
 #include <nanobind/stl/tuple.h>
 #include <nanobind/ndarray.h>
 
-#include <fstream>
-#include <sstream>
-
 #include "tensormidi/tensormidi.h"
+#include "tensormidi/tensormidi_c.h"
+#include "tensormidi/io.h"
+#include "tensormidi/parallel.h"
+#include "tensormidi/columns.h"
+#include "tensormidi/arrow.h"
+#include "tensormidi/cache.h"
+#include "tensormidi/shard.h"
+#include "tensormidi/sampler.h"
+#include "tensormidi/layout.h"
+#include "tensormidi/probe.h"
+#include "tensormidi/metadata.h"
+#include "tensormidi/lru.h"
+#include "tensormidi/dedup.h"
+#include "tensormidi/minhash.h"
+#include "tensormidi/stats.h"
+#include "tensormidi/tokenize.h"
+#include "tensormidi/bpe.h"
+#include "tensormidi/pianoroll.h"
 
 namespace nb = nanobind;
 namespace midi = tensormidi;
 
-std::tuple<
+using Loaded = std::tuple<
     std::vector<nb::ndarray<nb::numpy, uint8_t>>, // tracks
     nb::ndarray<nb::numpy, uint8_t>, // tempos
-    uint32_t // ticks_per_beat
->
-load_midi(
-    std::string filename, 
+    uint32_t, // ticks_per_beat
+    std::vector<nb::ndarray<nb::numpy, double>>, // beats
+    std::vector<nb::ndarray<nb::numpy, float>> // residual
+>;
+
+using Buffer = nb::ndarray<uint8_t, nb::c_contig, nb::device::cpu>;
+using ConstBuffer = nb::ndarray<const uint8_t, nb::c_contig, nb::device::cpu>;
+
+char const* time_unit_names[] = { "ticks", "seconds", "beats", "grid" };
+
+midi::Options make_options(
     bool merge_tracks, 
-    bool seconds, 
+    std::string const& time_unit, 
     bool notes_only,
-    int default_program=0 )
+    int default_program,
+    int steps_per_beat )
+{
+    midi::Options opt;
+    opt.merge_tracks = merge_tracks;
+    opt.notes_only = notes_only;
+    opt.default_program = default_program;
+    opt.steps_per_beat = steps_per_beat;
+    if(time_unit == "ticks") opt.time_unit = midi::Options::TICKS;
+    else if(time_unit == "seconds") opt.time_unit = midi::Options::SECONDS;
+    else if(time_unit == "beats") opt.time_unit = midi::Options::BEATS;
+    else if(time_unit == "grid") opt.time_unit = midi::Options::GRID;
+    else midi::err("bad time_unit");
+    return opt;
+}
+
+midi::File parse_midi(
+    uint8_t const* data,
+    size_t size,
+    midi::Options const& opt,
+    bool beat_column,
+    bool residual )
 {
-    std::stringstream iss;
-    iss << std::ifstream(filename, std::ios::binary).rdbuf();
-    std::string data_str = iss.str();
+    !beat_column || opt.time_unit == midi::Options::SECONDS 
+        || midi::err("beat_column requires seconds");
+    !residual || opt.time_unit == midi::Options::GRID 
+        || midi::err("residual requires grid");
 
-    uint8_t const* raw = (uint8_t const*)data_str.data();
-    midi::Stream src {raw, raw+data_str.size()};
+    midi::Stream src {data, data+size};
+
+    midi::File f { src, opt.notes_only, opt.default_program };
+
+    if(opt.merge_tracks) f.merge_tracks();
+    if(opt.time_unit == midi::Options::SECONDS) f.to_seconds(beat_column);
+    if(opt.time_unit == midi::Options::BEATS) f.to_beats();
+    if(opt.time_unit == midi::Options::GRID) f.quantize(opt.steps_per_beat, residual);
+    return f;
+}
 
-    midi::File f { src, notes_only, default_program };
+midi::File parse_midi(
+    std::string const& data, 
+    midi::Options const& opt,
+    bool beat_column,
+    bool residual )
+{
+    return parse_midi((uint8_t const*)data.data(), data.size(), 
+        opt, beat_column, residual);
+}
 
-    if(merge_tracks) f.merge_tracks();
-    if(seconds) f.to_seconds();
+nb::ndarray<nb::numpy, uint8_t> wrap_tempos(std::vector<midi::Tempo> && tempos)
+{
+    using TempoList = std::vector<midi::Tempo>;
+    TempoList * buf = new TempoList(std::move(tempos));
+    nb::capsule deleter(buf, [] (void *p) noexcept {
+        delete (TempoList *) p;
+    });
+    return nb::ndarray<nb::numpy, uint8_t>(
+        reinterpret_cast<uint8_t*>(buf->data()),
+        { buf->size(), sizeof(midi::Tempo) },
+        deleter
+    );
+}
 
-    using TrackList = std::vector<midi::Track>;
-    TrackList * buf = new TrackList(std::move(f.tracks));
+nb::ndarray<nb::numpy, uint8_t> wrap_events(std::vector<midi::Event> && events)
+{
+    using EventList = std::vector<midi::Event>;
+    EventList * buf = new EventList(std::move(events));
     nb::capsule deleter(buf, [] (void *p) noexcept {
-        delete (TrackList *) p;
+        delete (EventList *) p;
+    });
+    return nb::ndarray<nb::numpy, uint8_t>(
+        reinterpret_cast<uint8_t*>(buf->data()),
+        { buf->size(), sizeof(midi::Event) },
+        deleter
+    );
+}
+
+template<class T>
+nb::ndarray<nb::numpy, T> wrap_vector(std::vector<T> && values, size_t width=1)
+{
+    using List = std::vector<T>;
+    List * buf = new List(std::move(values));
+    nb::capsule deleter(buf, [] (void *p) noexcept {
+        delete (List *) p;
+    });
+    if(width == 1)
+        return nb::ndarray<nb::numpy, T>(buf->data(), { buf->size() }, deleter);
+    return nb::ndarray<nb::numpy, T>(
+        buf->data(), 
+        { buf->size() / width, width }, 
+        deleter
+    );
+}
+
+// views share ownership of the parsed file, which may also sit in parse_cache
+Loaded wrap_midi(
+    std::shared_ptr<midi::File> f, 
+    bool with_tempos,
+    bool beat_column,
+    bool residual )
+{
+    using FileRef = std::shared_ptr<midi::File>;
+    nb::capsule deleter(new FileRef(f), [] (void *p) noexcept {
+        delete (FileRef *) p;
     });
 
     std::vector<nb::ndarray<nb::numpy, uint8_t>> out;
-    for(int i=0 ; i<buf->size() ; i++)
+    std::vector<nb::ndarray<nb::numpy, double>> beat_out;
+    std::vector<nb::ndarray<nb::numpy, float>> residual_out;
+    for(int i=0 ; i<f->tracks.size() ; i++)
     {
-        midi::Track & t = (*buf)[i];
+        midi::Track & t = f->tracks[i];
         out.push_back(
             nb::ndarray<nb::numpy, uint8_t>(
                 reinterpret_cast<uint8_t*>(t.events.data()),
@@ -53,35 +165,1786 @@ load_midi(
                 deleter
             )
         );
+        if(beat_column)
+        {
+            beat_out.push_back(
+                nb::ndarray<nb::numpy, double>(
+                    t.beats.data(), { t.beats.size() }, deleter
+                )
+            );
+        }
+        if(residual)
+        {
+            residual_out.push_back(
+                nb::ndarray<nb::numpy, float>(
+                    t.residual.data(), { t.residual.size() }, deleter
+                )
+            );
+        }
     }
 
     nb::ndarray<nb::numpy, uint8_t> tempos {nullptr, {0}, nb::handle()};
-    if(!seconds)
+    if(with_tempos)
     {
-        using TempoList = std::vector<midi::Tempo>;
-        TempoList * buf = new TempoList(std::move(f.tempos));
-        nb::capsule deleter(buf, [] (void *p) noexcept {
-            delete (TempoList *) p;
-        });
         tempos = nb::ndarray<nb::numpy, uint8_t>(
-            reinterpret_cast<uint32_t*>(buf->data()),
-            { buf->size(), sizeof(midi::Tempo) },
+            reinterpret_cast<uint8_t*>(f->tempos.data()),
+            { f->tempos.size(), sizeof(midi::Tempo) },
             deleter
         );
     }
 
-    return {out, tempos, f.ticks_per_beat};
+    return {out, tempos, f->ticks_per_beat, beat_out, residual_out};
+}
+
+// Parsed files by (path, size, mtime, options), off until given a capacity
+midi::LruCache<std::string, midi::File> parse_cache;
+
+size_t file_bytes(midi::File const& f)
+{
+    size_t n = sizeof(f) + f.tempos.size() * sizeof(midi::Tempo);
+    for(midi::Track const& t : f.tracks)
+    {
+        n += sizeof(t) + t.events.size() * sizeof(midi::Event) 
+            + t.beats.size() * sizeof(double) + t.residual.size() * sizeof(float);
+    }
+    return n;
+}
+
+// safe without the GIL, the cache has its own lock
+std::shared_ptr<midi::File> load_file(
+    std::string const& filename,
+    midi::Options const& opt,
+    bool beat_column,
+    bool residual )
+{
+    if(!parse_cache.capacity())
+    {
+        return std::make_shared<midi::File>(
+            parse_midi(midi::read_file(filename), opt, beat_column, residual));
+    }
+
+    midi::FileStamp stamp { filename };
+    std::string key = filename;
+    auto add = [&] (auto x) { key.append((char const*) &x, sizeof(x)); };
+    add('\0');
+    add(stamp.size);
+    add(stamp.mtime_ns);
+    add(opt.merge_tracks);
+    add(opt.notes_only);
+    add(opt.default_program);
+    add(opt.time_unit);
+    add(opt.steps_per_beat);
+    add(beat_column);
+    add(residual);
+
+    if(std::shared_ptr<midi::File> hit = parse_cache.get(key)) { return hit; }
+    auto f = std::make_shared<midi::File>(
+        parse_midi(midi::read_file(filename), opt, beat_column, residual));
+    parse_cache.put(key, f, file_bytes(*f));
+    return f;
+}
+
+Loaded load_midi(
+    std::string filename, 
+    bool merge_tracks, 
+    std::string time_unit, 
+    bool notes_only,
+    int default_program=0,
+    bool beat_column=false,
+    int steps_per_beat=0,
+    bool residual=false )
+{
+    midi::Options opt = make_options(merge_tracks, time_unit, 
+        notes_only, default_program, steps_per_beat);
+
+    std::shared_ptr<midi::File> f;
+    {
+        nb::gil_scoped_release unlock;
+        f = load_file(filename, opt, beat_column, residual);
+    }
+    return wrap_midi(f, opt.time_unit == midi::Options::TICKS, 
+        beat_column, residual);
+}
+
+std::vector<Loaded> load_batch(
+    std::vector<std::string> const& filenames, 
+    bool merge_tracks, 
+    std::string time_unit, 
+    bool notes_only,
+    int default_program=0,
+    bool beat_column=false,
+    int steps_per_beat=0,
+    bool residual=false,
+    int threads=0 )
+{
+    midi::Options opt = make_options(merge_tracks, time_unit, 
+        notes_only, default_program, steps_per_beat);
+
+    std::vector<std::shared_ptr<midi::File>> files(filenames.size());
+    {
+        nb::gil_scoped_release unlock;
+        midi::parallel_for(files.size(), threads, [&] (size_t i, int) {
+            try
+            {
+                files[i] = load_file(filenames[i], opt, beat_column, residual);
+            }
+            catch(std::exception const& e)
+            {
+                midi::err((filenames[i] + ": " + e.what()).c_str());
+            }
+        });
+    }
+
+    std::vector<Loaded> out;
+    for(std::shared_ptr<midi::File> & f : files)
+        out.push_back(wrap_midi(f, opt.time_unit == midi::Options::TICKS, 
+            beat_column, residual));
+    return out;
+}
+
+// rows of out are independent per-file event buffers
+size_t buffer_capacity(Buffer const& out)
+{
+    size_t row_bytes = out.ndim() ? out.shape(out.ndim()-1) : 0;
+    row_bytes % sizeof(midi::Event) == 0 || midi::err("out rows must hold whole events");
+    return row_bytes / sizeof(midi::Event);
+}
+
+std::tuple<
+    size_t, // events in file, written up to capacity
+    nb::ndarray<nb::numpy, uint8_t>, // tempos
+    uint32_t // ticks_per_beat
+>
+load_into(
+    std::string filename, 
+    Buffer out,
+    bool merge_tracks, 
+    std::string time_unit, 
+    bool notes_only,
+    int default_program=0,
+    int steps_per_beat=0 )
+{
+    midi::Options opt = make_options(merge_tracks, time_unit, 
+        notes_only, default_program, steps_per_beat);
+    out.ndim() == 1 || midi::err("out must be 1-d");
+    size_t capacity = buffer_capacity(out);
+    midi::Event * events = reinterpret_cast<midi::Event*>(out.data());
+
+    std::vector<midi::Tempo> tempos;
+    int ticks_per_beat = 0;
+    size_t n = 0;
+    {
+        nb::gil_scoped_release unlock;
+        std::string data = midi::read_file(filename);
+        uint8_t const* raw = (uint8_t const*)data.data();
+        midi::Stream src {raw, raw+data.size()};
+        n = midi::parse_into(src, opt, events, capacity, tempos, &ticks_per_beat);
+    }
+    return {n, wrap_tempos(std::move(tempos)), ticks_per_beat};
+}
+
+std::vector<size_t> load_batch_into(
+    std::vector<std::string> const& filenames, 
+    Buffer out,
+    bool merge_tracks, 
+    std::string time_unit, 
+    bool notes_only,
+    int default_program=0,
+    int steps_per_beat=0,
+    int threads=0 )
+{
+    midi::Options opt = make_options(merge_tracks, time_unit, 
+        notes_only, default_program, steps_per_beat);
+    out.ndim() == 2 || midi::err("out must be 2-d");
+    out.shape(0) >= filenames.size() || midi::err("out has too few rows");
+    size_t capacity = buffer_capacity(out);
+    midi::Event * events = reinterpret_cast<midi::Event*>(out.data());
+
+    std::vector<size_t> counts(filenames.size());
+    {
+        nb::gil_scoped_release unlock;
+        midi::parallel_for(counts.size(), threads, [&] (size_t i, int) {
+            // scratch per worker thread, reused across the files of one batch
+            thread_local std::vector<midi::Tempo> tempos;
+            thread_local std::string data;
+            try
+            {
+                midi::read_file(filenames[i], data);
+                uint8_t const* raw = (uint8_t const*)data.data();
+                midi::Stream src {raw, raw+data.size()};
+                counts[i] = midi::parse_into(src, opt, 
+                    events + i * capacity, capacity, tempos);
+            }
+            catch(std::exception const& e)
+            {
+                midi::err((filenames[i] + ": " + e.what()).c_str());
+            }
+        });
+    }
+    return counts;
+}
+
+// an empty Framework pack yields bare arrays that speak __dlpack__
+template<class Time, class... Framework>
+nb::dict wrap_columns(midi::Columns<Time> && cols)
+{
+    using ColumnList = midi::Columns<Time>;
+    ColumnList * buf = new ColumnList(std::move(cols));
+    nb::capsule deleter(buf, [] (void *p) noexcept {
+        delete (ColumnList *) p;
+    });
+
+    size_t n = buf->size();
+    auto field = [&] (std::vector<uint8_t> & col) {
+        return nb::cast(nb::ndarray<Framework..., uint8_t, nb::ndim<1>>(
+            col.data(), { n }, deleter));
+    };
+    nb::dict out;
+    out["time"] = nb::cast(nb::ndarray<Framework..., Time, nb::ndim<1>>(
+        buf->time.data(), { n }, deleter));
+    out["track"] = field(buf->track);
+    out["program"] = field(buf->program);
+    out["channel"] = field(buf->channel);
+    out["type"] = field(buf->type);
+    out["key"] = field(buf->key);
+    out["value"] = field(buf->value);
+    return out;
+}
+
+template<class Time, class... Framework>
+std::vector<nb::dict> wrap_tracks(std::vector<midi::Track> const& tracks)
+{
+    std::vector<nb::dict> out;
+    for(midi::Track const& t : tracks)
+    {
+        midi::Event const* e = t.events.data();
+        out.push_back(wrap_columns<Time, Framework...>(
+            midi::Columns<Time>(e, e + t.events.size())));
+    }
+    return out;
+}
+
+template<class Time>
+std::vector<nb::dict> wrap_tracks_as(
+    std::vector<midi::Track> const& tracks, 
+    std::string const& framework )
+{
+    if(framework == "numpy") return wrap_tracks<Time, nb::numpy>(tracks);
+    if(framework == "torch") return wrap_tracks<Time, nb::pytorch>(tracks);
+    if(framework == "jax") return wrap_tracks<Time, nb::jax>(tracks);
+    if(framework == "dlpack") return wrap_tracks<Time>(tracks);
+    midi::err("bad framework");
+    return {};
+}
+
+std::vector<nb::dict> load_columns(
+    std::string filename, 
+    std::string framework,
+    std::string time_dtype,
+    bool merge_tracks, 
+    std::string time_unit, 
+    bool notes_only,
+    int default_program=0,
+    int steps_per_beat=0 )
+{
+    midi::Options opt = make_options(merge_tracks, time_unit, 
+        notes_only, default_program, steps_per_beat);
+
+    midi::File f;
+    {
+        nb::gil_scoped_release unlock;
+        f = parse_midi(midi::read_file(filename), opt, false, false);
+    }
+
+    if(time_dtype == "float64") return wrap_tracks_as<double>(f.tracks, framework);
+    if(time_dtype == "float32") return wrap_tracks_as<float>(f.tracks, framework);
+    midi::err("bad time_dtype");
+    return {};
+}
+
+midi::EventTable load_batch_arrow(
+    std::vector<std::string> const& filenames, 
+    bool merge_tracks, 
+    std::string time_unit, 
+    bool notes_only,
+    int default_program=0,
+    int steps_per_beat=0,
+    int threads=0 )
+{
+    midi::Options opt = make_options(merge_tracks, time_unit, 
+        notes_only, default_program, steps_per_beat);
+
+    nb::gil_scoped_release unlock;
+    std::vector<midi::File> files(filenames.size());
+    midi::parallel_for(files.size(), threads, [&] (size_t i, int) {
+        try
+        {
+            files[i] = parse_midi(midi::read_file(filenames[i]), opt, false, false);
+        }
+        catch(std::exception const& e)
+        {
+            midi::err((filenames[i] + ": " + e.what()).c_str());
+        }
+    });
+    return midi::EventTable(files);
+}
+
+void save_cache(
+    std::string filename,
+    std::vector<ConstBuffer> tracks,
+    ConstBuffer tempos,
+    int ticks_per_beat,
+    std::string time_unit,
+    bool merged,
+    int steps_per_beat=0 )
+{
+    midi::Options opt = make_options(merged, time_unit, 
+        true, 0, steps_per_beat);
+
+    midi::File f;
+    f.ticks_per_beat = ticks_per_beat;
+    tempos.size() % sizeof(midi::Tempo) == 0 || midi::err("bad tempo array");
+    midi::Tempo const* tp = (midi::Tempo const*) tempos.data();
+    f.tempos.assign(tp, tp + tempos.size() / sizeof(midi::Tempo));
+    for(ConstBuffer const& t : tracks)
+    {
+        t.size() % sizeof(midi::Event) == 0 || midi::err("bad event array");
+        midi::Event const* e = (midi::Event const*) t.data();
+        f.tracks.emplace_back();
+        f.tracks.back().events.assign(e, e + t.size() / sizeof(midi::Event));
+    }
+
+    nb::gil_scoped_release unlock;
+    midi::write_cache(filename, f, opt, false);
+}
+
+using Cached = std::tuple<
+    std::vector<nb::ndarray<nb::numpy, uint8_t>>, // tracks
+    nb::ndarray<nb::numpy, uint8_t>, // tempos
+    uint32_t, // ticks_per_beat
+    std::string, // time_unit
+    bool, // merged
+    int32_t, // steps_per_beat
+    uint32_t, // notes_only, 0 unknown, 1 notes only, 2 all events
+    int32_t // default_program
+>;
+
+// views into a .tmidi image, kept alive by owner
+Cached wrap_cache(midi::CacheView const& view, nb::capsule owner)
+{
+    std::vector<nb::ndarray<nb::numpy, uint8_t>> tracks;
+    for(size_t i=0 ; i<view.n_tracks() ; i++)
+    {
+        tracks.push_back(
+            nb::ndarray<nb::numpy, uint8_t>(
+                reinterpret_cast<uint8_t*>(view.track(i)),
+                { view.track_size(i), sizeof(midi::Event) },
+                owner
+            )
+        );
+    }
+    nb::ndarray<nb::numpy, uint8_t> tempos(
+        const_cast<midi::Tempo*>(view.tempos),
+        { view.head->n_tempos, sizeof(midi::Tempo) },
+        owner
+    );
+    view.head->time_unit <= midi::Options::GRID || midi::err("bad time_unit");
+    return {tracks, tempos, view.head->ticks_per_beat, 
+        time_unit_names[view.head->time_unit], view.head->merged,
+        view.head->steps_per_beat, view.head->notes_only, view.head->default_program};
+}
+
+Cached load_cached(std::string filename)
+{
+    midi::MappedFile * map = new midi::MappedFile();
+    nb::capsule deleter(map, [] (void *p) noexcept {
+        delete (midi::MappedFile *) p;
+    });
+    *map = midi::MappedFile(filename);
+    return wrap_cache(midi::CacheView { map->data, map->size }, deleter);
+}
+
+void pack(
+    std::vector<std::string> const& filenames, 
+    std::string out,
+    bool parsed,
+    bool merge_tracks, 
+    std::string time_unit, 
+    bool notes_only,
+    int default_program=0,
+    int steps_per_beat=0,
+    int threads=0 )
+{
+    midi::Options opt = make_options(merge_tracks, time_unit, 
+        notes_only, default_program, steps_per_beat);
+    nb::gil_scoped_release unlock;
+    midi::pack_shard(filenames, out, 
+        parsed ? midi::ShardHeader::PARSED : midi::ShardHeader::RAW, opt, threads);
+}
+
+// numpy views into the shard hold a reference to the whole mapping
+struct ShardRef
+{
+    std::shared_ptr<midi::Shard> shard;
+    // kept between calls so raw files keep their seek indexes
+    mutable std::shared_ptr<midi::Sampler> sampler;
+
+    ShardRef(std::string const& path)
+    :   shard(std::make_shared<midi::Shard>(path))
+    {
+    }
+
+    nb::capsule owner() const
+    {
+        using Ref = std::shared_ptr<midi::Shard>;
+        return nb::capsule(new Ref(shard), [] (void *p) noexcept {
+            delete (Ref *) p;
+        });
+    }
+
+    nb::ndarray<nb::numpy, uint8_t> index() const
+    {
+        return nb::ndarray<nb::numpy, uint8_t>(
+            const_cast<midi::ShardEntry*>(shard->index),
+            { shard->size(), sizeof(midi::ShardEntry) },
+            owner()
+        );
+    }
+
+    nb::ndarray<nb::numpy, uint8_t> raw(size_t i) const
+    {
+        return nb::ndarray<nb::numpy, uint8_t>(
+            shard->data(i), { shard->length(i) }, owner());
+    }
+
+    Loaded load(
+        size_t i,
+        bool merge_tracks, 
+        std::string time_unit, 
+        bool notes_only,
+        int default_program=0,
+        bool beat_column=false,
+        int steps_per_beat=0,
+        bool residual=false ) const
+    {
+        !shard->parsed() || midi::err("shard holds parsed files, use load_cached");
+        midi::Options opt = make_options(merge_tracks, time_unit, 
+            notes_only, default_program, steps_per_beat);
+        auto f = std::make_shared<midi::File>(parse_midi(
+            shard->data(i), shard->length(i), opt, beat_column, residual));
+        return wrap_midi(f, opt.time_unit == midi::Options::TICKS, 
+            beat_column, residual);
+    }
+
+    Cached load_cached(size_t i) const
+    {
+        return wrap_cache(shard->cache(i), owner());
+    }
+
+    // call with the GIL held, the returned sampler is safe to use without it
+    std::shared_ptr<midi::Sampler> sampler_for(midi::Options const& opt) const
+    {
+        midi::Options const* old = sampler ? &sampler->opt : nullptr;
+        if(!old || old->notes_only != opt.notes_only || old->time_unit != opt.time_unit
+            || old->default_program != opt.default_program 
+            || old->steps_per_beat != opt.steps_per_beat)
+        {
+            sampler = std::make_shared<midi::Sampler>(*shard, opt);
+        }
+        return sampler;
+    }
+
+    std::tuple<
+        std::vector<uint32_t>, // files
+        std::vector<uint32_t> // events per window
+    >
+    sample_events(
+        size_t batch,
+        uint64_t seed,
+        Buffer out,
+        bool notes_only,
+        std::string time_unit, 
+        int default_program=0,
+        int steps_per_beat=0,
+        int threads=0 ) const
+    {
+        midi::Options opt = make_options(true, time_unit, 
+            notes_only, default_program, steps_per_beat);
+        out.ndim() == 2 || midi::err("out must be 2-d");
+        out.shape(0) >= batch || midi::err("out has too few rows");
+        size_t n = buffer_capacity(out);
+        std::vector<uint32_t> files(batch), counts(batch);
+        std::shared_ptr<midi::Sampler> sampler = sampler_for(opt);
+        {
+            nb::gil_scoped_release unlock;
+            midi::sample_events(*sampler, n, batch, seed, 
+                reinterpret_cast<midi::Event*>(out.data()), 
+                files.data(), counts.data(), threads);
+        }
+        return {files, counts};
+    }
+
+    std::tuple<
+        nb::ndarray<nb::numpy, uint8_t>, // events
+        std::vector<int64_t>, // offsets
+        std::vector<uint32_t> // files
+    >
+    sample_time(
+        size_t batch,
+        uint64_t seed,
+        double length,
+        bool notes_only,
+        std::string time_unit, 
+        int default_program=0,
+        int steps_per_beat=0,
+        int threads=0 ) const
+    {
+        midi::Options opt = make_options(true, time_unit, 
+            notes_only, default_program, steps_per_beat);
+        std::vector<midi::Event> events;
+        std::vector<int64_t> offsets;
+        std::vector<uint32_t> files(batch);
+        std::shared_ptr<midi::Sampler> sampler = sampler_for(opt);
+        {
+            nb::gil_scoped_release unlock;
+            midi::sample_time(*sampler, length, batch, seed, 
+                events, offsets, files.data(), threads);
+        }
+        return {wrap_events(std::move(events)), offsets, files};
+    }
+};
+
+// A midi file held in memory with only its chunk layout parsed.
+// Tracks are decoded when asked for, the tempo map once on first need.
+struct LazyMidi
+{
+    std::string data;
+    midi::Layout layout;
+    std::optional<std::vector<midi::Tempo>> tempo_map;
+
+    LazyMidi(std::string const& filename)
+    :   data(midi::read_file(filename))
+    {
+        layout = midi::Layout(midi::Stream { bytes(), bytes() + data.size() });
+    }
+
+    uint8_t const* bytes() const { return (uint8_t const*) data.data(); }
+
+    std::vector<midi::Tempo> const& tempos()
+    {
+        if(!tempo_map) { tempo_map = layout.tempos(bytes()); }
+        return *tempo_map;
+    }
+
+    std::vector<size_t> track_lengths() const
+    {
+        std::vector<size_t> out;
+        for(midi::Layout::Chunk const& c : layout.tracks) { out.push_back(c.length); }
+        return out;
+    }
+
+    midi::Track & convert(midi::Track & t, midi::Options const& opt)
+    {
+        double tpb = layout.header.ticks_per_beat;
+        if(opt.time_unit == midi::Options::SECONDS) t.to_seconds(tpb, tempos());
+        if(opt.time_unit == midi::Options::BEATS) t.to_beats(tpb);
+        if(opt.time_unit == midi::Options::GRID)
+        {
+            opt.steps_per_beat > 0 || midi::err("steps_per_beat must be positive");
+            t.quantize(tpb, opt.steps_per_beat);
+        }
+        return t;
+    }
+
+    nb::ndarray<nb::numpy, uint8_t> track(
+        size_t i,
+        std::string time_unit, 
+        bool notes_only,
+        int default_program=0,
+        int steps_per_beat=0 )
+    {
+        midi::Options opt = make_options(false, time_unit, 
+            notes_only, default_program, steps_per_beat);
+        midi::Track t = layout.decode(bytes(), i, notes_only, default_program);
+        return wrap_events(std::move(convert(t, opt).events));
+    }
+
+    nb::ndarray<nb::numpy, uint8_t> merged(
+        std::string time_unit, 
+        bool notes_only,
+        int default_program=0,
+        int steps_per_beat=0 )
+    {
+        midi::Options opt = make_options(true, time_unit, 
+            notes_only, default_program, steps_per_beat);
+        midi::File f;
+        for(size_t i=0 ; i<layout.tracks.size() ; i++)
+            f.tracks.push_back(layout.decode(bytes(), i, notes_only, default_program));
+        f.merge_tracks();
+        return wrap_events(std::move(convert(f.tracks[0], opt).events));
+    }
+};
+
+std::tuple<
+    int, // type
+    int, // n_tracks
+    int, // ticks_per_beat
+    uint64_t, // file size
+    std::vector<uint32_t>, // track lengths
+    uint64_t // event estimate
+>
+probe(std::string filename, bool estimate, size_t prefix)
+{
+    nb::gil_scoped_release unlock;
+    midi::Probe p = midi::probe(filename, estimate, prefix);
+    return {p.type, p.n_tracks, p.ticks_per_beat, p.file_size, 
+        p.track_lengths, p.events};
+}
+
+// columns of Probe, track lengths flattened with per-file offsets
+std::tuple<
+    std::vector<int32_t>, // type
+    std::vector<int32_t>, // n_tracks
+    std::vector<int32_t>, // ticks_per_beat
+    std::vector<uint64_t>, // file size
+    std::vector<uint32_t>, // track lengths
+    std::vector<int64_t>, // track offsets
+    std::vector<uint64_t>, // event estimate
+    std::vector<int32_t> // status
+>
+probe_batch(
+    std::vector<std::string> const& filenames, 
+    bool estimate, 
+    size_t prefix,
+    int threads=0 )
+{
+    std::vector<midi::Probe> probes;
+    {
+        nb::gil_scoped_release unlock;
+        probes = midi::probe_batch(filenames, estimate, prefix, threads);
+    }
+    std::vector<int32_t> type, n_tracks, ticks_per_beat, status;
+    std::vector<uint64_t> size, events;
+    std::vector<uint32_t> lengths;
+    std::vector<int64_t> offsets {0};
+    for(midi::Probe const& p : probes)
+    {
+        type.push_back(p.type);
+        n_tracks.push_back(p.n_tracks);
+        ticks_per_beat.push_back(p.ticks_per_beat);
+        size.push_back(p.file_size);
+        lengths.insert(lengths.end(), p.track_lengths.begin(), p.track_lengths.end());
+        offsets.push_back(lengths.size());
+        events.push_back(p.events);
+        status.push_back(p.status);
+    }
+    return {type, n_tracks, ticks_per_beat, size, lengths, offsets, events, status};
+}
+
+nb::ndarray<nb::numpy, uint8_t> describe_batch(
+    std::vector<std::string> const& filenames, 
+    int default_program=0,
+    int threads=0 )
+{
+    using Rows = std::vector<midi::Metadata>;
+    Rows * rows = new Rows();
+    nb::capsule deleter(rows, [] (void *p) noexcept {
+        delete (Rows *) p;
+    });
+    {
+        nb::gil_scoped_release unlock;
+        *rows = midi::describe_batch(filenames, default_program, threads);
+    }
+    return nb::ndarray<nb::numpy, uint8_t>(
+        reinterpret_cast<uint8_t*>(rows->data()),
+        { rows->size(), sizeof(midi::Metadata) },
+        deleter
+    );
+}
+
+std::tuple<
+    std::vector<uint64_t>, // hashes
+    std::vector<int32_t>, // status
+    std::vector<int64_t> // groups
+>
+content_hashes(
+    std::vector<std::string> const& filenames, 
+    int resolution,
+    bool ignore_program,
+    bool velocity,
+    int threads=0 )
+{
+    midi::DedupOptions opt;
+    resolution > 0 || midi::err("resolution must be positive");
+    opt.resolution = resolution;
+    opt.ignore_program = ignore_program;
+    opt.velocity = velocity;
+    nb::gil_scoped_release unlock;
+    midi::ContentHashes out = midi::content_hashes(filenames, opt, threads);
+    return {out.hashes, out.status, out.groups};
+}
+
+std::tuple<
+    nb::ndarray<nb::numpy, uint32_t>, // signatures
+    std::vector<int32_t> // status
+>
+minhash_signatures(
+    std::vector<std::string> const& filenames, 
+    int ngram,
+    int resolution,
+    int bands,
+    int rows,
+    uint64_t seed,
+    int threads=0 )
+{
+    midi::MinHashOptions opt;
+    opt.ngram = ngram;
+    opt.resolution = resolution;
+    opt.bands = bands;
+    opt.rows = rows;
+    opt.seed = seed;
+    midi::MinHashes * hashes = new midi::MinHashes();
+    nb::capsule deleter(hashes, [] (void *p) noexcept {
+        delete (midi::MinHashes *) p;
+    });
+    {
+        nb::gil_scoped_release unlock;
+        *hashes = midi::minhash_signatures(filenames, opt, threads);
+    }
+    nb::ndarray<nb::numpy, uint32_t> signatures(
+        hashes->signatures.data(),
+        { filenames.size(), hashes->length },
+        deleter
+    );
+    return {signatures, hashes->status};
+}
+
+std::tuple<
+    std::vector<int64_t>, // a
+    std::vector<int64_t>, // b
+    std::vector<float> // similarity
+>
+lsh_pairs(
+    nb::ndarray<const uint32_t, nb::ndim<2>, nb::c_contig, nb::device::cpu> signatures,
+    int bands,
+    int rows,
+    float threshold,
+    int threads=0 )
+{
+    (bands > 0 && rows > 0) || midi::err("bands and rows must be positive");
+    signatures.shape(1) == size_t(bands) * rows 
+        || midi::err("signature length must be bands * rows");
+    std::vector<midi::SimilarPair> pairs;
+    {
+        nb::gil_scoped_release unlock;
+        pairs = midi::lsh_pairs(signatures.data(), signatures.shape(0), 
+            bands, rows, threshold, threads);
+    }
+    std::vector<int64_t> a, b;
+    std::vector<float> similarity;
+    for(midi::SimilarPair const& p : pairs)
+    {
+        a.push_back(p.a);
+        b.push_back(p.b);
+        similarity.push_back(p.similarity);
+    }
+    return {a, b, similarity};
+}
+
+// name -> (counts, lo, width), plus file counts
+nb::dict corpus_stats(std::vector<std::string> const& filenames, 
+    int default_program=0, int threads=0)
+{
+    midi::CorpusStats stats;
+    {
+        nb::gil_scoped_release unlock;
+        stats = midi::corpus_stats(filenames, default_program, threads);
+    }
+    nb::dict out;
+    stats.each([&] (char const* name, midi::Histogram & h) {
+        out[name] = nb::make_tuple(h.counts, h.lo, h.width);
+    });
+    out["files"] = stats.files;
+    out["failed"] = stats.failed;
+    return out;
+}
+
+using EventArray = nb::ndarray<const uint8_t, nb::ndim<2>, nb::c_contig, nb::device::cpu>;
+
+midi::Event const* event_data(EventArray const& events)
+{
+    events.shape(1) == sizeof(midi::Event) || midi::err("events must be rows of 16 bytes");
+    return reinterpret_cast<midi::Event const*>(events.data());
+}
+
+template<class T>
+using RaggedArrays = std::tuple<
+    nb::ndarray<nb::numpy, T>, // tokens
+    std::vector<int64_t>, // offsets
+    std::vector<int32_t> // status
+>;
+
+template<class T>
+RaggedArrays<T> wrap_ragged(midi::Ragged<T> && tokens)
+{
+    return {
+        wrap_vector(std::move(tokens.values), tokens.width),
+        std::move(tokens.offsets),
+        std::move(tokens.status)
+    };
+}
+
+midi::MidiLike make_midi_like(
+    int steps_per_second, 
+    int max_shift, 
+    int velocity_bins, 
+    bool programs, 
+    int default_program )
+{
+    midi::MidiLike tok;
+    tok.steps_per_second = steps_per_second;
+    tok.max_shift = max_shift;
+    tok.velocity_bins = velocity_bins;
+    tok.programs = programs;
+    tok.default_program = default_program;
+    tok.check();
+    return tok;
+}
+
+RaggedArrays<int32_t> tokenize_midi_like(
+    std::vector<std::string> const& filenames, 
+    int steps_per_second,
+    int max_shift,
+    int velocity_bins,
+    bool programs,
+    int default_program,
+    int threads=0 )
+{
+    midi::MidiLike tok = make_midi_like(steps_per_second, max_shift, 
+        velocity_bins, programs, default_program);
+    midi::Ragged<int32_t> out;
+    {
+        nb::gil_scoped_release unlock;
+        out = midi::tokenize_batch<int32_t>(filenames, 1, threads, tok);
+    }
+    return wrap_ragged(std::move(out));
+}
+
+// events in seconds, merged
+nb::ndarray<nb::numpy, int32_t> events_to_midi_like(
+    EventArray events,
+    int steps_per_second,
+    int max_shift,
+    int velocity_bins,
+    bool programs )
+{
+    midi::MidiLike tok = make_midi_like(steps_per_second, max_shift, 
+        velocity_bins, programs, 0);
+    midi::Event const* begin = event_data(events);
+    std::vector<int32_t> out;
+    {
+        nb::gil_scoped_release unlock;
+        tok(begin, begin + events.shape(0), out);
+    }
+    return wrap_vector(std::move(out));
+}
+
+template<class Tokenizer>
+Tokenizer make_grid_tokens(
+    int steps_per_beat,
+    int max_bar,
+    int max_duration,
+    int velocity_bins,
+    int tempo_bins,
+    double min_bpm,
+    double max_bpm,
+    int default_program )
+{
+    Tokenizer tok;
+    tok.steps_per_beat = steps_per_beat;
+    tok.max_bar = max_bar;
+    tok.max_duration = max_duration;
+    tok.velocity_bins = velocity_bins;
+    tok.tempo_bins = tempo_bins;
+    tok.min_bpm = min_bpm;
+    tok.max_bpm = max_bpm;
+    tok.default_program = default_program;
+    tok.check();
+    return tok;
+}
+
+midi::Remi make_remi(
+    int steps_per_beat,
+    int max_bar,
+    int max_duration,
+    int velocity_bins,
+    int tempo_bins,
+    double min_bpm,
+    double max_bpm,
+    bool programs,
+    bool bar_lengths,
+    int default_program )
+{
+    midi::Remi tok = make_grid_tokens<midi::Remi>(steps_per_beat, max_bar, 
+        max_duration, velocity_bins, tempo_bins, min_bpm, max_bpm, default_program);
+    tok.programs = programs;
+    tok.bar_lengths = bar_lengths;
+    return tok;
+}
+
+RaggedArrays<int32_t> tokenize_remi(
+    std::vector<std::string> const& filenames, 
+    int steps_per_beat,
+    int max_bar,
+    int max_duration,
+    int velocity_bins,
+    int tempo_bins,
+    double min_bpm,
+    double max_bpm,
+    bool programs,
+    bool bar_lengths,
+    int default_program,
+    int threads=0 )
+{
+    midi::Remi tok = make_remi(steps_per_beat, max_bar, max_duration, velocity_bins, 
+        tempo_bins, min_bpm, max_bpm, programs, bar_lengths, default_program);
+    midi::Ragged<int32_t> out;
+    {
+        nb::gil_scoped_release unlock;
+        out = midi::tokenize_batch<int32_t>(filenames, 1, threads, tok);
+    }
+    return wrap_ragged(std::move(out));
+}
+
+// rows of Octuple::FIELDS per note
+RaggedArrays<int16_t> tokenize_octuple(
+    std::vector<std::string> const& filenames, 
+    int steps_per_beat,
+    int max_bar,
+    int max_duration,
+    int velocity_bins,
+    int tempo_bins,
+    double min_bpm,
+    double max_bpm,
+    int default_program,
+    int threads=0 )
+{
+    midi::Octuple tok = make_grid_tokens<midi::Octuple>(steps_per_beat, max_bar, 
+        max_duration, velocity_bins, tempo_bins, min_bpm, max_bpm, default_program);
+    midi::Ragged<int16_t> out;
+    {
+        nb::gil_scoped_release unlock;
+        out = midi::tokenize_batch<int16_t>(filenames, midi::Octuple::FIELDS, threads, tok);
+    }
+    return wrap_ragged(std::move(out));
+}
+
+template<class T>
+using TokenArray = nb::ndarray<const T, nb::c_contig, nb::device::cpu>;
+using OffsetArray = nb::ndarray<const int64_t, nb::ndim<1>, nb::c_contig, nb::device::cpu>;
+
+// rows of tokens, width values each
+template<class T>
+size_t token_rows(TokenArray<T> const& tokens, size_t width)
+{
+    (width == 1 ? tokens.ndim() == 1 : tokens.ndim() == 2 && tokens.shape(1) == width)
+        || midi::err("tokens have the wrong shape");
+    return tokens.shape(0);
+}
+
+// merged events in seconds
+nb::ndarray<nb::numpy, uint8_t> sequence_events(midi::Sequence && seq)
+{
+    midi::ticks_to_seconds(seq.events.data(), seq.events.data() + seq.events.size(),
+        seq.ticks_per_beat, seq.tempos);
+    return wrap_events(std::move(seq.events));
+}
+
+template<class T, class Tokenizer>
+nb::ndarray<nb::numpy, uint8_t> detokenize(Tokenizer const& tok, 
+    TokenArray<T> const& tokens, size_t width)
+{
+    size_t rows = token_rows(tokens, width);
+    midi::Sequence seq;
+    {
+        nb::gil_scoped_release unlock;
+        tok.decode(tokens.data(), rows, seq);
+    }
+    return sequence_events(std::move(seq));
+}
+
+// midi files back to back, file i at [offsets[i], offsets[i+1])
+template<class T, class Tokenizer>
+std::tuple<
+    nb::ndarray<nb::numpy, uint8_t>, // data
+    std::vector<int64_t> // offsets
+>
+detokenize_midi(Tokenizer const& tok, TokenArray<T> const& tokens, 
+    size_t width, OffsetArray const& offsets, int threads)
+{
+    size_t rows = token_rows(tokens, width);
+    size_t n = offsets.shape(0);
+    (n > 0 && offsets.data()[n-1] <= int64_t(rows)) 
+        || midi::err("offsets must end within tokens");
+    std::vector<uint8_t> data;
+    std::vector<int64_t> starts { 0 };
+    {
+        nb::gil_scoped_release unlock;
+        std::vector<std::string> files = midi::detokenize_batch(tok, tokens.data(), 
+            offsets.data(), n - 1, width, threads);
+        for(std::string const& f : files)
+        {
+            data.insert(data.end(), f.begin(), f.end());
+            starts.push_back(data.size());
+        }
+    }
+    return {wrap_vector(std::move(data)), starts};
+}
+
+nb::ndarray<nb::numpy, uint8_t> midi_like_to_events(
+    TokenArray<int32_t> tokens,
+    int steps_per_second,
+    int max_shift,
+    int velocity_bins,
+    bool programs,
+    int default_program )
+{
+    midi::MidiLike tok = make_midi_like(steps_per_second, max_shift, 
+        velocity_bins, programs, default_program);
+    size_t rows = token_rows(tokens, 1);
+    std::vector<midi::Event> events;
+    {
+        nb::gil_scoped_release unlock;
+        tok.decode(tokens.data(), rows, events);
+    }
+    return wrap_events(std::move(events));
+}
+
+std::tuple<nb::ndarray<nb::numpy, uint8_t>, std::vector<int64_t>> midi_like_to_midi(
+    TokenArray<int32_t> tokens,
+    OffsetArray offsets,
+    int steps_per_second,
+    int max_shift,
+    int velocity_bins,
+    bool programs,
+    int default_program,
+    int threads=0 )
+{
+    midi::MidiLike tok = make_midi_like(steps_per_second, max_shift, 
+        velocity_bins, programs, default_program);
+    return detokenize_midi(tok, tokens, 1, offsets, threads);
+}
+
+nb::ndarray<nb::numpy, uint8_t> remi_to_events(
+    TokenArray<int32_t> tokens,
+    int steps_per_beat,
+    int max_bar,
+    int max_duration,
+    int velocity_bins,
+    int tempo_bins,
+    double min_bpm,
+    double max_bpm,
+    bool programs,
+    bool bar_lengths,
+    int default_program )
+{
+    midi::Remi tok = make_remi(steps_per_beat, max_bar, max_duration, velocity_bins, 
+        tempo_bins, min_bpm, max_bpm, programs, bar_lengths, default_program);
+    return detokenize(tok, tokens, 1);
+}
+
+std::tuple<nb::ndarray<nb::numpy, uint8_t>, std::vector<int64_t>> remi_to_midi(
+    TokenArray<int32_t> tokens,
+    OffsetArray offsets,
+    int steps_per_beat,
+    int max_bar,
+    int max_duration,
+    int velocity_bins,
+    int tempo_bins,
+    double min_bpm,
+    double max_bpm,
+    bool programs,
+    bool bar_lengths,
+    int default_program,
+    int threads=0 )
+{
+    midi::Remi tok = make_remi(steps_per_beat, max_bar, max_duration, velocity_bins, 
+        tempo_bins, min_bpm, max_bpm, programs, bar_lengths, default_program);
+    return detokenize_midi(tok, tokens, 1, offsets, threads);
+}
+
+nb::ndarray<nb::numpy, uint8_t> octuple_to_events(
+    TokenArray<int16_t> tokens,
+    int steps_per_beat,
+    int max_bar,
+    int max_duration,
+    int velocity_bins,
+    int tempo_bins,
+    double min_bpm,
+    double max_bpm )
+{
+    midi::Octuple tok = make_grid_tokens<midi::Octuple>(steps_per_beat, max_bar, 
+        max_duration, velocity_bins, tempo_bins, min_bpm, max_bpm, 0);
+    return detokenize(tok, tokens, midi::Octuple::FIELDS);
+}
+
+std::tuple<nb::ndarray<nb::numpy, uint8_t>, std::vector<int64_t>> octuple_to_midi(
+    TokenArray<int16_t> tokens,
+    OffsetArray offsets,
+    int steps_per_beat,
+    int max_bar,
+    int max_duration,
+    int velocity_bins,
+    int tempo_bins,
+    double min_bpm,
+    double max_bpm,
+    int threads=0 )
+{
+    midi::Octuple tok = make_grid_tokens<midi::Octuple>(steps_per_beat, max_bar, 
+        max_duration, velocity_bins, tempo_bins, min_bpm, max_bpm, 0);
+    return detokenize_midi(tok, tokens, midi::Octuple::FIELDS, offsets, threads);
+}
+
+midi::Bpe make_bpe(int32_t base, nb::ndarray<const int32_t, nb::ndim<2>, nb::c_contig, nb::device::cpu> merges)
+{
+    merges.shape(1) == 2 || midi::err("merges must be pairs");
+    std::vector<midi::Bpe::Pair> pairs;
+    for(size_t i=0 ; i<merges.shape(0) ; i++)
+        pairs.push_back({ merges.data()[2*i], merges.data()[2*i+1] });
+    return midi::Bpe(base, std::move(pairs));
+}
+
+size_t ragged_count(TokenArray<int32_t> const& tokens, OffsetArray const& offsets)
+{
+    size_t rows = token_rows(tokens, 1);
+    size_t n = offsets.shape(0);
+    (n > 0 && offsets.data()[n-1] <= int64_t(rows)) 
+        || midi::err("offsets must end within tokens");
+    (offsets.data()[0] >= 0 && offsets.data()[0] <= offsets.data()[n-1])
+        || midi::err("offsets must be ascending");
+    return n - 1;
+}
+
+midi::Bpe train_bpe(
+    TokenArray<int32_t> tokens,
+    OffsetArray offsets,
+    int32_t base,
+    int32_t vocab_size,
+    int64_t min_count,
+    int threads=0 )
+{
+    size_t n = ragged_count(tokens, offsets);
+    nb::gil_scoped_release unlock;
+    return midi::train_bpe(tokens.data(), offsets.data(), n, 
+        base, vocab_size, min_count, threads);
+}
+
+template<bool Encode>
+RaggedArrays<int32_t> bpe_apply(
+    midi::Bpe const& bpe,
+    TokenArray<int32_t> tokens,
+    OffsetArray offsets,
+    int threads=0 )
+{
+    size_t n = ragged_count(tokens, offsets);
+    midi::Ragged<int32_t> out;
+    {
+        nb::gil_scoped_release unlock;
+        out = Encode ? bpe.encode_batch(tokens.data(), offsets.data(), n, threads)
+            : bpe.decode_batch(tokens.data(), offsets.data(), n, threads);
+    }
+    return wrap_ragged(std::move(out));
+}
+
+midi::RollOptions make_roll_options(
+    double fps,
+    bool velocity,
+    bool onsets,
+    bool offsets,
+    bool sustain,
+    bool packed,
+    std::string group,
+    int64_t frames,
+    int default_program )
+{
+    midi::RollOptions opt;
+    opt.fps = fps;
+    opt.velocity = velocity;
+    opt.onsets = onsets;
+    opt.offsets = offsets;
+    opt.sustain = sustain;
+    opt.packed = packed;
+    if(group == "none") { opt.group = midi::RollOptions::NONE; }
+    else if(group == "tracks") { opt.group = midi::RollOptions::TRACKS; }
+    else if(group == "programs") { opt.group = midi::RollOptions::PROGRAMS; }
+    else { midi::err("group must be none, tracks or programs"); }
+    opt.frames = frames;
+    opt.default_program = default_program;
+    opt.check();
+    return opt;
+}
+
+using RollArrays = std::tuple<
+    nb::ndarray<nb::numpy, uint8_t>, // [groups, channels, frames, row bytes]
+    std::vector<int32_t> // groups
+>;
+
+RollArrays wrap_roll(midi::Roll && roll)
+{
+    using Bytes = std::vector<uint8_t>;
+    Bytes * buf = new Bytes(std::move(roll.data));
+    nb::capsule deleter(buf, [] (void *p) noexcept {
+        delete (Bytes *) p;
+    });
+    nb::ndarray<nb::numpy, uint8_t> data(
+        buf->data(),
+        { roll.groups.size(), size_t(roll.channels), size_t(roll.frames), roll.row_bytes },
+        deleter
+    );
+    return {data, std::move(roll.groups)};
+}
+
+using SparseRollArrays = std::tuple<
+    nb::ndarray<nb::numpy, int64_t>, // [4, nnz] group, channel, frame, key
+    nb::ndarray<nb::numpy, uint8_t>, // [nnz] values
+    int64_t, // frames
+    std::vector<int32_t> // groups
+>;
+
+SparseRollArrays wrap_roll(midi::SparseRoll && roll)
+{
+    using Indices = std::vector<int64_t>;
+    Indices * buf = new Indices(std::move(roll.indices));
+    nb::capsule deleter(buf, [] (void *p) noexcept {
+        delete (Indices *) p;
+    });
+    nb::ndarray<nb::numpy, int64_t> indices(
+        buf->data(),
+        { 4, roll.values.size() },
+        deleter
+    );
+    return {indices, wrap_vector(std::move(roll.values)), roll.frames, std::move(roll.groups)};
+}
+
+// merged events in seconds, to a dense Roll or a SparseRoll
+template<class Out>
+auto pianoroll(
+    EventArray events,
+    double fps,
+    bool velocity,
+    bool onsets,
+    bool offsets,
+    bool sustain,
+    bool packed,
+    std::string group,
+    int64_t frames )
+{
+    midi::RollOptions opt = make_roll_options(fps, velocity, onsets, offsets, 
+        sustain, packed, group, frames, 0);
+    midi::Event const* begin = event_data(events);
+    Out roll;
+    {
+        nb::gil_scoped_release unlock;
+        midi::pianoroll(begin, begin + events.shape(0), opt, roll);
+    }
+    return wrap_roll(std::move(roll));
+}
+
+template<class Out>
+auto pianoroll_batch(
+    std::vector<std::string> const& filenames, 
+    double fps,
+    bool velocity,
+    bool onsets,
+    bool offsets,
+    bool sustain,
+    bool packed,
+    std::string group,
+    int64_t frames,
+    int default_program,
+    int threads=0 )
+{
+    midi::RollOptions opt = make_roll_options(fps, velocity, onsets, offsets, 
+        sustain, packed, group, frames, default_program);
+    std::vector<Out> rolls;
+    {
+        nb::gil_scoped_release unlock;
+        rolls = midi::pianoroll_batch<Out>(filenames, opt, threads);
+    }
+    std::vector<decltype(wrap_roll(std::move(rolls[0])))> out;
+    std::vector<int32_t> status;
+    for(Out & r : rolls)
+    {
+        status.push_back(r.status);
+        out.push_back(wrap_roll(std::move(r)));
+    }
+    return std::make_tuple(std::move(out), status);
+}
+
+// PyCapsules per the Arrow PyCapsule Interface, released if never consumed
+nb::capsule arrow_schema(midi::EventTable const& table)
+{
+    ArrowSchema * schema = new ArrowSchema;
+    table.export_schema(schema);
+    return nb::capsule(schema, "arrow_schema", [] (void *p) noexcept {
+        ArrowSchema * schema = (ArrowSchema *) p;
+        if(schema->release) schema->release(schema);
+        delete schema;
+    });
+}
+
+nb::capsule arrow_array(midi::EventTable const& table)
+{
+    ArrowArray * array = new ArrowArray;
+    table.export_array(array);
+    return nb::capsule(array, "arrow_array", [] (void *p) noexcept {
+        ArrowArray * array = (ArrowArray *) p;
+        if(array->release) array->release(array);
+        delete array;
+    });
 }
 
 NB_MODULE(tensormidi_bind, m)
 {
     using namespace nanobind::literals;
 
+    nb::class_<midi::EventTable>(m, "EventTable")
+        .def("__len__", &midi::EventTable::rows)
+        .def("__arrow_c_schema__", &arrow_schema)
+        .def("__arrow_c_array__", 
+            [] (midi::EventTable const& t, nb::object requested_schema) {
+                return std::make_tuple(arrow_schema(t), arrow_array(t));
+            }, 
+            "requested_schema"_a = nb::none()
+        );
+
     m.def("load_midi", &load_midi, 
         "filename"_a,
         "merge_tracks"_a = true,
-        "seconds"_a = true,
+        "time_unit"_a = "seconds",
+        "notes_only"_a = true,
+        "default_program"_a = 0,
+        "beat_column"_a = false,
+        "steps_per_beat"_a = 0,
+        "residual"_a = false
+    );
+
+    nb::class_<ShardRef>(m, "Shard")
+        .def(nb::init<std::string>(), "path"_a)
+        .def("__len__", [] (ShardRef const& s) { return s.shard->size(); })
+        .def_prop_ro("parsed", [] (ShardRef const& s) { return s.shard->parsed(); })
+        .def("index", &ShardRef::index)
+        .def("raw", &ShardRef::raw, "i"_a)
+        .def("load", &ShardRef::load, 
+            "i"_a,
+            "merge_tracks"_a = true,
+            "time_unit"_a = "seconds",
+            "notes_only"_a = true,
+            "default_program"_a = 0,
+            "beat_column"_a = false,
+            "steps_per_beat"_a = 0,
+            "residual"_a = false
+        )
+        .def("load_cached", &ShardRef::load_cached, "i"_a)
+        .def("sample_events", &ShardRef::sample_events, 
+            "batch"_a,
+            "seed"_a,
+            "out"_a.noconvert(),
+            "notes_only"_a = true,
+            "time_unit"_a = "seconds",
+            "default_program"_a = 0,
+            "steps_per_beat"_a = 0,
+            "threads"_a = 0
+        )
+        .def("sample_time", &ShardRef::sample_time, 
+            "batch"_a,
+            "seed"_a,
+            "length"_a,
+            "notes_only"_a = true,
+            "time_unit"_a = "seconds",
+            "default_program"_a = 0,
+            "steps_per_beat"_a = 0,
+            "threads"_a = 0
+        );
+
+    nb::class_<LazyMidi>(m, "LazyMidi")
+        .def(nb::init<std::string>(), "filename"_a)
+        .def_prop_ro("type", [] (LazyMidi const& f) { return f.layout.header.type; })
+        .def_prop_ro("ticks_per_beat", 
+            [] (LazyMidi const& f) { return f.layout.header.ticks_per_beat; })
+        .def("track_lengths", &LazyMidi::track_lengths)
+        .def("tempos", [] (LazyMidi & f) { 
+            return wrap_tempos(std::vector<midi::Tempo>(f.tempos())); })
+        .def("track", &LazyMidi::track, 
+            "i"_a,
+            "time_unit"_a = "seconds",
+            "notes_only"_a = true,
+            "default_program"_a = 0,
+            "steps_per_beat"_a = 0
+        )
+        .def("merged", &LazyMidi::merged, 
+            "time_unit"_a = "seconds",
+            "notes_only"_a = true,
+            "default_program"_a = 0,
+            "steps_per_beat"_a = 0
+        );
+
+    m.def("probe", &probe, 
+        "filename"_a,
+        "estimate"_a = false,
+        "prefix"_a = 4096
+    );
+
+    m.def("probe_batch", &probe_batch, 
+        "filenames"_a,
+        "estimate"_a = false,
+        "prefix"_a = 4096,
+        "threads"_a = 0
+    );
+
+    m.def("describe_batch", &describe_batch, 
+        "filenames"_a,
+        "default_program"_a = 0,
+        "threads"_a = 0
+    );
+
+    m.def("set_cache", [] (size_t max_bytes) { 
+        parse_cache.set_capacity(max_bytes); }, "max_bytes"_a);
+
+    m.def("clear_cache", [] () { parse_cache.clear(); });
+
+    m.def("cache_info", [] () {
+        auto s = parse_cache.stats();
+        nb::dict out;
+        out["capacity"] = s.capacity;
+        out["bytes"] = s.cost;
+        out["entries"] = s.entries;
+        out["hits"] = s.hits;
+        out["misses"] = s.misses;
+        return out;
+    });
+
+    m.def("content_hashes", &content_hashes, 
+        "filenames"_a,
+        "resolution"_a = 960,
+        "ignore_program"_a = false,
+        "velocity"_a = false,
+        "threads"_a = 0
+    );
+
+    m.def("minhash_signatures", &minhash_signatures, 
+        "filenames"_a,
+        "ngram"_a = 4,
+        "resolution"_a = 12,
+        "bands"_a = 16,
+        "rows"_a = 8,
+        "seed"_a = 0,
+        "threads"_a = 0
+    );
+
+    m.def("lsh_pairs", &lsh_pairs, 
+        "signatures"_a,
+        "bands"_a = 16,
+        "rows"_a = 8,
+        "threshold"_a = 0,
+        "threads"_a = 0
+    );
+
+    m.def("corpus_stats", &corpus_stats, 
+        "filenames"_a,
+        "default_program"_a = 0,
+        "threads"_a = 0
+    );
+
+    m.def("tokenize_midi_like", &tokenize_midi_like, 
+        "filenames"_a,
+        "steps_per_second"_a,
+        "max_shift"_a,
+        "velocity_bins"_a,
+        "programs"_a,
+        "default_program"_a,
+        "threads"_a = 0
+    );
+
+    m.def("events_to_midi_like", &events_to_midi_like, 
+        "events"_a,
+        "steps_per_second"_a,
+        "max_shift"_a,
+        "velocity_bins"_a,
+        "programs"_a
+    );
+
+    m.def("tokenize_remi", &tokenize_remi, 
+        "filenames"_a,
+        "steps_per_beat"_a,
+        "max_bar"_a,
+        "max_duration"_a,
+        "velocity_bins"_a,
+        "tempo_bins"_a,
+        "min_bpm"_a,
+        "max_bpm"_a,
+        "programs"_a,
+        "bar_lengths"_a,
+        "default_program"_a,
+        "threads"_a = 0
+    );
+
+    m.def("tokenize_octuple", &tokenize_octuple, 
+        "filenames"_a,
+        "steps_per_beat"_a,
+        "max_bar"_a,
+        "max_duration"_a,
+        "velocity_bins"_a,
+        "tempo_bins"_a,
+        "min_bpm"_a,
+        "max_bpm"_a,
+        "default_program"_a,
+        "threads"_a = 0
+    );
+
+    m.def("midi_like_to_events", &midi_like_to_events, 
+        "tokens"_a,
+        "steps_per_second"_a,
+        "max_shift"_a,
+        "velocity_bins"_a,
+        "programs"_a,
+        "default_program"_a
+    );
+
+    m.def("midi_like_to_midi", &midi_like_to_midi, 
+        "tokens"_a,
+        "offsets"_a,
+        "steps_per_second"_a,
+        "max_shift"_a,
+        "velocity_bins"_a,
+        "programs"_a,
+        "default_program"_a,
+        "threads"_a = 0
+    );
+
+    m.def("remi_to_events", &remi_to_events, 
+        "tokens"_a,
+        "steps_per_beat"_a,
+        "max_bar"_a,
+        "max_duration"_a,
+        "velocity_bins"_a,
+        "tempo_bins"_a,
+        "min_bpm"_a,
+        "max_bpm"_a,
+        "programs"_a,
+        "bar_lengths"_a,
+        "default_program"_a
+    );
+
+    m.def("remi_to_midi", &remi_to_midi, 
+        "tokens"_a,
+        "offsets"_a,
+        "steps_per_beat"_a,
+        "max_bar"_a,
+        "max_duration"_a,
+        "velocity_bins"_a,
+        "tempo_bins"_a,
+        "min_bpm"_a,
+        "max_bpm"_a,
+        "programs"_a,
+        "bar_lengths"_a,
+        "default_program"_a,
+        "threads"_a = 0
+    );
+
+    m.def("octuple_to_events", &octuple_to_events, 
+        "tokens"_a,
+        "steps_per_beat"_a,
+        "max_bar"_a,
+        "max_duration"_a,
+        "velocity_bins"_a,
+        "tempo_bins"_a,
+        "min_bpm"_a,
+        "max_bpm"_a
+    );
+
+    m.def("octuple_to_midi", &octuple_to_midi, 
+        "tokens"_a,
+        "offsets"_a,
+        "steps_per_beat"_a,
+        "max_bar"_a,
+        "max_duration"_a,
+        "velocity_bins"_a,
+        "tempo_bins"_a,
+        "min_bpm"_a,
+        "max_bpm"_a,
+        "threads"_a = 0
+    );
+
+    nb::class_<midi::Bpe>(m, "Bpe")
+        .def("__init__", [] (midi::Bpe * self, int32_t base, 
+                nb::ndarray<const int32_t, nb::ndim<2>, nb::c_contig, nb::device::cpu> merges) {
+                new (self) midi::Bpe(make_bpe(base, merges));
+            },
+            "base"_a,
+            "merges"_a
+        )
+        .def_ro("base", &midi::Bpe::base)
+        .def_prop_ro("vocab_size", &midi::Bpe::vocab_size)
+        .def_prop_ro("merges", [] (midi::Bpe const& b) {
+            std::vector<int32_t> flat;
+            for(auto [x, y] : b.merges) { flat.push_back(x); flat.push_back(y); }
+            return wrap_vector(std::move(flat), 2);
+        })
+        .def("encode", &bpe_apply<true>, 
+            "tokens"_a,
+            "offsets"_a,
+            "threads"_a = 0
+        )
+        .def("decode", &bpe_apply<false>, 
+            "tokens"_a,
+            "offsets"_a,
+            "threads"_a = 0
+        );
+
+    m.def("train_bpe", &train_bpe, 
+        "tokens"_a,
+        "offsets"_a,
+        "base"_a,
+        "vocab_size"_a,
+        "min_count"_a,
+        "threads"_a = 0
+    );
+
+    m.def("pianoroll", &pianoroll<midi::Roll>, 
+        "events"_a,
+        "fps"_a,
+        "velocity"_a,
+        "onsets"_a,
+        "offsets"_a,
+        "sustain"_a,
+        "packed"_a,
+        "group"_a,
+        "frames"_a
+    );
+
+    m.def("pianoroll_batch", &pianoroll_batch<midi::Roll>, 
+        "filenames"_a,
+        "fps"_a,
+        "velocity"_a,
+        "onsets"_a,
+        "offsets"_a,
+        "sustain"_a,
+        "packed"_a,
+        "group"_a,
+        "frames"_a,
+        "default_program"_a,
+        "threads"_a = 0
+    );
+
+    m.def("sparse_pianoroll", &pianoroll<midi::SparseRoll>, 
+        "events"_a,
+        "fps"_a,
+        "velocity"_a,
+        "onsets"_a,
+        "offsets"_a,
+        "sustain"_a,
+        "packed"_a,
+        "group"_a,
+        "frames"_a
+    );
+
+    m.def("sparse_pianoroll_batch", &pianoroll_batch<midi::SparseRoll>, 
+        "filenames"_a,
+        "fps"_a,
+        "velocity"_a,
+        "onsets"_a,
+        "offsets"_a,
+        "sustain"_a,
+        "packed"_a,
+        "group"_a,
+        "frames"_a,
+        "default_program"_a,
+        "threads"_a = 0
+    );
+
+    m.def("pack", &pack, 
+        "filenames"_a,
+        "out"_a,
+        "parsed"_a = false,
+        "merge_tracks"_a = true,
+        "time_unit"_a = "seconds",
+        "notes_only"_a = true,
+        "default_program"_a = 0,
+        "steps_per_beat"_a = 0,
+        "threads"_a = 0
+    );
+
+    m.def("load_batch", &load_batch, 
+        "filenames"_a,
+        "merge_tracks"_a = true,
+        "time_unit"_a = "seconds",
+        "notes_only"_a = true,
+        "default_program"_a = 0,
+        "beat_column"_a = false,
+        "steps_per_beat"_a = 0,
+        "residual"_a = false,
+        "threads"_a = 0
+    );
+
+    m.def("load_into", &load_into, 
+        "filename"_a,
+        "out"_a.noconvert(),
+        "merge_tracks"_a = true,
+        "time_unit"_a = "seconds",
+        "notes_only"_a = true,
+        "default_program"_a = 0,
+        "steps_per_beat"_a = 0
+    );
+
+    m.def("load_batch_into", &load_batch_into, 
+        "filenames"_a,
+        "out"_a.noconvert(),
+        "merge_tracks"_a = true,
+        "time_unit"_a = "seconds",
+        "notes_only"_a = true,
+        "default_program"_a = 0,
+        "steps_per_beat"_a = 0,
+        "threads"_a = 0
+    );
+
+    m.def("load_batch_arrow", &load_batch_arrow, 
+        "filenames"_a,
+        "merge_tracks"_a = true,
+        "time_unit"_a = "seconds",
+        "notes_only"_a = true,
+        "default_program"_a = 0,
+        "steps_per_beat"_a = 0,
+        "threads"_a = 0
+    );
+
+    m.def("save_cache", &save_cache, 
+        "filename"_a,
+        "tracks"_a,
+        "tempos"_a,
+        "ticks_per_beat"_a,
+        "time_unit"_a,
+        "merged"_a,
+        "steps_per_beat"_a = 0
+    );
+
+    m.def("load_cached", &load_cached, 
+        "filename"_a
+    );
+
+    // tensormidi_c.cpp is compiled in, numba calls it through ctypes
+    m.def("parse_into_address", [] () {
+        return (uintptr_t) &tensormidi_parse_into;
+    });
+
+    m.def("load_columns", &load_columns, 
+        "filename"_a,
+        "framework"_a = "numpy",
+        "time_dtype"_a = "float64",
+        "merge_tracks"_a = true,
+        "time_unit"_a = "seconds",
         "notes_only"_a = true,
-        "default_program"_a = 0
+        "default_program"_a = 0,
+        "steps_per_beat"_a = 0
     );
 }
\ No newline at end of file
@@ -0,0 +1,160 @@
+#include <string>
+
+#include "tensormidi/tensormidi.h"
+#include "tensormidi/tensormidi_c.h"
+#include "tensormidi/io.h"
+
+namespace midi = tensormidi;
+
+static_assert(sizeof(tensormidi_event) == sizeof(midi::Event), "event layout");
+static_assert(sizeof(tensormidi_tempo) == sizeof(midi::Tempo), "tempo layout");
+
+struct tensormidi_file
+{
+    midi::File file;
+};
+
+namespace {
+
+thread_local std::string last_error;
+
+bool valid(int32_t time_unit)
+{
+    return time_unit >= midi::Options::TICKS && time_unit <= midi::Options::GRID;
+}
+
+midi::Options make_options(tensormidi_options const& o)
+{
+    valid(o.time_unit) || midi::err("bad time_unit");
+    midi::Options opt;
+    opt.merge_tracks = o.merge_tracks;
+    opt.time_unit = midi::Options::TimeUnit(o.time_unit);
+    opt.notes_only = o.notes_only;
+    opt.default_program = o.default_program;
+    opt.steps_per_beat = o.steps_per_beat;
+    return opt;
+}
+
+} // namespace
+
+extern "C" {
+
+int32_t tensormidi_version(void)
+{
+    return TENSORMIDI_C_API_VERSION;
+}
+
+tensormidi_options tensormidi_default_options(void)
+{
+    return { 1, TENSORMIDI_SECONDS, 1, 0, 0 };
+}
+
+tensormidi_file * tensormidi_open_buffer(
+    uint8_t const* data, size_t size, tensormidi_options const* opt)
+{
+    try
+    {
+        midi::Stream src {data, data+size};
+        return new tensormidi_file { midi::parse_file(src, 
+            make_options(opt ? *opt : tensormidi_default_options())) };
+    }
+    catch(std::exception const& e)
+    {
+        last_error = e.what();
+        return nullptr;
+    }
+}
+
+tensormidi_file * tensormidi_open_path(
+    char const* path, tensormidi_options const* opt)
+{
+    std::string data;
+    try
+    {
+        midi::read_file(path, data);
+    }
+    catch(std::exception const& e)
+    {
+        last_error = e.what();
+        return nullptr;
+    }
+    return tensormidi_open_buffer((uint8_t const*)data.data(), data.size(), opt);
+}
+
+void tensormidi_free(tensormidi_file * file)
+{
+    delete file;
+}
+
+char const* tensormidi_last_error(void)
+{
+    return last_error.c_str();
+}
+
+int32_t tensormidi_format(tensormidi_file const* file)
+{
+    return file->file.type;
+}
+
+int32_t tensormidi_ticks_per_beat(tensormidi_file const* file)
+{
+    return file->file.ticks_per_beat;
+}
+
+size_t tensormidi_track_count(tensormidi_file const* file)
+{
+    return file->file.tracks.size();
+}
+
+tensormidi_event const* tensormidi_track_events(
+    tensormidi_file const* file, size_t track, size_t * count)
+{
+    if(track >= file->file.tracks.size())
+    {
+        *count = 0;
+        return nullptr;
+    }
+    auto const& events = file->file.tracks[track].events;
+    *count = events.size();
+    return (tensormidi_event const*) events.data();
+}
+
+tensormidi_tempo const* tensormidi_tempos(
+    tensormidi_file const* file, size_t * count)
+{
+    *count = file->file.tempos.size();
+    return (tensormidi_tempo const*) file->file.tempos.data();
+}
+
+int64_t tensormidi_parse_into(
+    void const* data, int64_t size,
+    void * out, int64_t capacity,
+    int32_t merge_tracks, 
+    int32_t time_unit, 
+    int32_t notes_only,
+    int32_t default_program,
+    int32_t steps_per_beat,
+    int32_t * ticks_per_beat )
+{
+    if(size < 0 || capacity < 0)
+    {
+        last_error = "size and capacity must not be negative";
+        return -1;
+    }
+    tensormidi_options opt { merge_tracks, time_unit, 
+        notes_only, default_program, steps_per_beat };
+    thread_local std::vector<midi::Tempo> tempos;
+    try
+    {
+        midi::Stream src {(uint8_t const*)data, (uint8_t const*)data + size};
+        return midi::parse_into(src, make_options(opt), 
+            (midi::Event *)out, capacity, tempos, ticks_per_beat);
+    }
+    catch(std::exception const& e)
+    {
+        last_error = e.what();
+        return -1;
+    }
+}
+
+} // extern "C"
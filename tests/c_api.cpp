@@ -0,0 +1,35 @@
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tensormidi/tensormidi_c.h"
+#include "tensormidi/io.h"
+#include "check.h"
+
+// every failing entry point leaves a reason in tensormidi_last_error
+void test_parse_into_errors()
+{
+    std::string data;
+    tensormidi::read_file("../example/bach/catech7.mid", data);
+    std::vector<tensormidi_event> out(4096);
+    int64_t n = tensormidi_parse_into(data.data(), data.size(), out.data(), out.size(),
+        1, TENSORMIDI_TICKS, 1, 0, 0, nullptr);
+    CHECK(n > 0 && n <= int64_t(out.size()));
+
+    auto fails = [&] (void const* bytes, int64_t size, int64_t capacity, int32_t unit) {
+        tensormidi_open_path("missing.mid", nullptr);
+        std::string before = tensormidi_last_error();
+        int64_t r = tensormidi_parse_into(bytes, size, out.data(), capacity, 
+            1, unit, 1, 0, 0, nullptr);
+        return r == -1 && std::strlen(tensormidi_last_error()) && before != tensormidi_last_error();
+    };
+    CHECK(fails(data.data(), 10, out.size(), TENSORMIDI_TICKS));
+    CHECK(fails(data.data(), data.size(), out.size(), 99));
+    CHECK(fails(data.data(), -1, out.size(), TENSORMIDI_TICKS));
+}
+
+int main()
+{
+    test_parse_into_errors();
+    return report("c_api");
+}
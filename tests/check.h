@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdlib>
+#include <iostream>
+
+// Minimal assertions for the header tests: report and count, fail at exit
+inline int & failures() { static int n = 0; return n; }
+
+#define CHECK(cond) do { if(!(cond)) { \
+    std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #cond ") failed" << std::endl; \
+    failures() ++; } } while(0)
+
+inline int report(char const* name)
+{
+    std::cout << name << ": " << (failures() ? "FAILED" : "ok") << std::endl;
+    return failures() ? 1 : 0;
+}
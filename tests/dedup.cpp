@@ -0,0 +1,29 @@
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "tensormidi/dedup.h"
+#include "tensormidi/write.h"
+#include "check.h"
+
+using namespace tensormidi;
+
+// files without notes get their own status and are never grouped together
+void test_empty_files()
+{
+    std::string bytes;
+    write_midi(Sequence {}, bytes);
+    std::ofstream("dedup_empty.mid", std::ios::binary) << bytes;
+    std::vector<std::string> paths { "dedup_empty.mid", "dedup_empty.mid", 
+        "../example/bach/catech7.mid", "../example/bach/catech7.mid", "missing.mid" };
+    ContentHashes out = content_hashes(paths);
+    CHECK((out.status == std::vector<int32_t> { 2, 2, 0, 0, 1 }));
+    CHECK((out.groups == std::vector<int64_t> { -1, -1, 2, 2, -1 }));
+    std::remove("dedup_empty.mid");
+}
+
+int main()
+{
+    test_empty_files();
+    return report("dedup");
+}
@@ -0,0 +1,33 @@
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "tensormidi/metadata.h"
+#include "tensormidi/write.h"
+#include "check.h"
+
+using namespace tensormidi;
+
+// a header without a usable time division fails rather than a NaN duration
+void test_bad_division()
+{
+    Sequence seq;
+    std::string bytes;
+    write_midi(seq, bytes);
+    for(uint16_t division : { 0x0000, 0xE728 })
+    {
+        bytes[12] = char(division >> 8);
+        bytes[13] = char(division);
+        std::ofstream("metadata_division.mid", std::ios::binary) << bytes;
+        std::vector<Metadata> rows = describe_batch({ "metadata_division.mid", "../example/bach/catech7.mid" });
+        CHECK(rows[0].status == 1);
+        CHECK(rows[1].status == 0 && rows[1].duration > 0);
+    }
+    std::remove("metadata_division.mid");
+}
+
+int main()
+{
+    test_bad_division();
+    return report("metadata");
+}
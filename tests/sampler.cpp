@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "tensormidi/sampler.h"
+#include "check.h"
+
+using namespace tensormidi;
+
+std::string const midi = "../example/bach/catech7.mid";
+
+// events at equal times may come in any order, so compare sorted bytes
+void canonical(std::vector<Event> & events)
+{
+    std::sort(events.begin(), events.end(), [] (Event const& a, Event const& b) {
+        return std::memcmp(&a, &b, sizeof(Event)) < 0;
+    });
+}
+
+// a window from a raw shard holds every event of the whole file between its
+// first and last event, including all of those sharing its last grid step
+void test_time_windows(Options::TimeUnit unit, int steps_per_beat, double length,
+    size_t seek_bytes = size_t(256) << 20)
+{
+    Options opt;
+    opt.time_unit = unit;
+    opt.steps_per_beat = steps_per_beat;
+    pack_shard({ midi }, "sampler_test.tmsh", ShardHeader::RAW, opt);
+    Shard shard { "sampler_test.tmsh" };
+    Sampler sampler { shard, opt, 256, seek_bytes };
+
+    std::string data;
+    read_file(midi, data);
+    Stream src { (u8 const*) data.data(), (u8 const*) data.data() + data.size() };
+    File file = parse_file(src, opt);
+    std::vector<Event> const& all = file.tracks[0].events;
+
+    Sampler::Rng rng { 1 };
+    std::vector<Event> window, expect;
+    for(int i=0 ; i<2000 ; i++)
+    {
+        sampler.crop_time(0, length, rng, window);
+        if(window.empty()) { continue; }
+        double first = window.front().time, last = window.back().time;
+        CHECK(last - first < length);
+        expect.clear();
+        for(Event const& e : all)
+            if(e.time >= first && e.time <= last) { expect.push_back(e); }
+        canonical(window);
+        canonical(expect);
+        CHECK(window.size() == expect.size());
+        CHECK(window.size() != expect.size() || std::equal(window.begin(), window.end(),
+            expect.begin(), [] (Event const& a, Event const& b) {
+                return std::memcmp(&a, &b, sizeof(Event)) == 0;
+            }));
+    }
+    // seek indexes stay within their budget, 0 keeps none
+    CHECK(sampler.seeks.stats().entries == (seek_bytes ? 1 : 0));
+    CHECK(sampler.seeks.stats().cost <= seek_bytes);
+}
+
+int main()
+{
+    test_time_windows(Options::TICKS, 0, 4 * 480);
+    test_time_windows(Options::BEATS, 0, 4);
+    test_time_windows(Options::GRID, 4, 6);
+    test_time_windows(Options::GRID, 12, 17);
+    test_time_windows(Options::GRID, 4, 6, 0);
+    std::remove("sampler_test.tmsh");
+    return report("sampler");
+}
@@ -0,0 +1,46 @@
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "tensormidi/stats.h"
+#include "tensormidi/write.h"
+#include "check.h"
+
+using namespace tensormidi;
+
+// drum notes count as program 128, others under their program
+void test_drum_programs()
+{
+    Sequence seq;
+    auto note = [&] (double tick, u8 type, u8 channel, u8 program) {
+        Event e {};
+        e.time = tick;
+        e.type = type;
+        e.channel = channel;
+        e.program = program;
+        e.key = 40;
+        e.value = 64;
+        seq.events.push_back(e);
+    };
+    note(0, Event::NOTE_ON, 9, 0);
+    note(0, Event::NOTE_ON, 0, 5);
+    note(480, Event::NOTE_OFF, 9, 0);
+    note(480, Event::NOTE_OFF, 0, 5);
+    std::string bytes;
+    write_midi(seq, bytes);
+    std::ofstream("stats_drums.mid", std::ios::binary) << bytes;
+
+    CorpusStats stats = corpus_stats({ "stats_drums.mid" });
+    std::remove("stats_drums.mid");
+    CHECK(stats.files == 1);
+    CHECK(stats.program.counts.size() == 129);
+    CHECK(stats.program.counts[128] == 1);
+    CHECK(stats.program.counts[5] == 1);
+    CHECK(stats.program.counts[0] == 0);
+}
+
+int main()
+{
+    test_drum_programs();
+    return report("stats");
+}
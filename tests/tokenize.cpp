@@ -0,0 +1,142 @@
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "tensormidi/tokenize.h"
+#include "check.h"
+
+using namespace tensormidi;
+
+std::string const midi = "../example/bach/catech7.mid";
+
+Event note(double time, u8 type, u8 key, u8 velocity = 64)
+{
+    Event e {};
+    e.time = time;
+    e.type = type;
+    e.key = key;
+    e.value = velocity;
+    return e;
+}
+
+// a step holding only a stray off emits nothing, not even its time shift
+void test_midi_like_stray_off()
+{
+    MidiLike tok;
+    tok.velocity_bins = 0;
+    std::vector<Event> events {
+        note(0, Event::NOTE_ON, 60),
+        note(0.5, Event::NOTE_OFF, 60),
+        note(1, Event::NOTE_OFF, 61),
+        note(2, Event::NOTE_ON, 62),
+        note(2.5, Event::NOTE_OFF, 62),
+    };
+    std::vector<int32_t> tokens;
+    tok(events.data(), events.data() + events.size(), tokens);
+    int shift = MidiLike::TIME_SHIFT - 1;
+    std::vector<int32_t> expect {
+        MidiLike::NOTE_ON + 60, shift + 50, MidiLike::NOTE_OFF + 60,
+        shift + 100, shift + 50, MidiLike::NOTE_ON + 62, shift + 50, MidiLike::NOTE_OFF + 62,
+    };
+    CHECK(tokens == expect);
+}
+
+Stream file(std::string & data)
+{
+    read_file(midi, data);
+    return { (u8 const*) data.data(), (u8 const*) data.data() + data.size() };
+}
+
+// tokenize, decode to a midi file, and tokenize that again
+template<class Tok, class T>
+void round_trip(Tok const& tok, size_t width)
+{
+    std::string data, bytes;
+    std::vector<T> tokens, again;
+    tok(file(data), tokens);
+    Sequence seq;
+    tok.decode(tokens.data(), tokens.size() / width, seq);
+    write_midi(seq, bytes);
+    tok(Stream { (u8 const*) bytes.data(), (u8 const*) bytes.data() + bytes.size() }, again);
+    CHECK(tokens.size() > 0);
+    CHECK(tokens == again);
+}
+
+// bars longer than max_bar are split in pieces, which decoding must follow
+void test_round_trips()
+{
+    for(int steps_per_beat : { 4, 12 })
+    {
+        // without programs, voices doubling a key on other channels merge
+        Remi remi;
+        remi.steps_per_beat = steps_per_beat;
+        remi.programs = true;
+        round_trip<Remi, int32_t>(remi, 1);
+        remi.bar_lengths = true;
+        round_trip<Remi, int32_t>(remi, 1);
+
+        Octuple octuple;
+        octuple.steps_per_beat = steps_per_beat;
+        round_trip<Octuple, int16_t>(octuple, Octuple::FIELDS);
+    }
+    MidiLike midi_like;
+    midi_like.programs = true;
+    round_trip<MidiLike, int32_t>(midi_like, 1);
+}
+
+// notes on one grid step share the tempo at that step, even when the tempo
+// changes between their unquantized ticks
+void test_tempo_on_grid()
+{
+    Sequence seq;
+    seq.tempos = { { 0, 0.5 }, { 40, 1.0 } };
+    for(double tick : { 0, 50 })
+    {
+        seq.events.push_back(note(tick, Event::NOTE_ON, 60 + tick / 10));
+        seq.events.push_back(note(tick + 480, Event::NOTE_OFF, 60 + tick / 10));
+    }
+    std::sort(seq.events.begin(), seq.events.end(), [] (auto& a, auto& b) { return a.time < b.time; });
+    std::string bytes;
+    write_midi(seq, bytes);
+    Stream src { (u8 const*) bytes.data(), (u8 const*) bytes.data() + bytes.size() };
+
+    Octuple octuple;
+    std::vector<int16_t> rows;
+    octuple(src, rows);
+    CHECK(rows.size() == 2 * Octuple::FIELDS);
+    CHECK(rows[Octuple::POSITION] == rows[Octuple::FIELDS + Octuple::POSITION]);
+    CHECK(rows[Octuple::TEMPO] == rows[Octuple::FIELDS + Octuple::TEMPO]);
+    CHECK(rows[Octuple::TEMPO] == octuple.tempo_bin(120));
+}
+
+// rows from a model are checked field by field before they become notes
+void test_octuple_bad_rows()
+{
+    Octuple octuple;
+    int16_t good[Octuple::FIELDS] = { 0, 4, 60, 2, 10, 0, 5, Octuple::time_signature(4, 4) };
+    Sequence seq;
+    octuple.decode(good, 1, seq);
+    CHECK(seq.events.size() == 2);
+    for(auto [field, value] : std::vector<std::pair<int, int16_t>> {
+        { Octuple::POSITION, -1 }, { Octuple::POSITION, 32 }, { Octuple::DURATION, 0 },
+        { Octuple::DURATION, 33 }, { Octuple::VELOCITY, 32 }, { Octuple::TEMPO, -1 },
+        { Octuple::TEMPO, 32 }, { Octuple::PITCH, 128 }, { Octuple::PROGRAM, 129 } })
+    {
+        int16_t row[Octuple::FIELDS];
+        std::copy(good, good + Octuple::FIELDS, row);
+        row[field] = value;
+        bool threw = false;
+        try { octuple.decode(row, 1, seq); }
+        catch(std::exception const&) { threw = true; }
+        CHECK(threw);
+    }
+}
+
+int main()
+{
+    test_midi_like_stray_off();
+    test_round_trips();
+    test_tempo_on_grid();
+    test_octuple_bad_rows();
+    return report("tokenize");
+}